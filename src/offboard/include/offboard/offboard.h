@@ -30,6 +30,14 @@
 #include<nav_msgs/Odometry.h>
 #include<eigen_conversions/eigen_msg.h>
 #include<stack>
+#include<cstring>
+#include<ros/topic.h>
+#include<offboard/seqlock.h>
+#include<offboard/vehicle_snapshot.h>
+#include<offboard/waypoint_store.h>
+#include<string>
+
+class ArrayQueue;
 
 class OffboardControl
 {
@@ -71,8 +79,10 @@ class OffboardControl
 	ros::ServiceClient set_mode_client_; // set OFFBOARD mode in simulation
 	ros::ServiceClient arming_client_; // call arm command in simulation
 
-	nav_msgs::Odometry current_odom_; // current odometry from mavros: pose (position + orientation) + twist (linear + angular)
-	mavros_msgs::State current_state_; // current state from mavros, check connect (onboard-pixhawk), arm, flight mode, ...
+	SeqLock<OdomSnapshot> odom_buf_; // latest odometry from mavros, written by odomCallback on any spinner thread
+	SeqLock<StateSnapshot> state_buf_; // latest state from mavros, written by stateCallback on any spinner thread
+	OdomSnapshot current_odom_; // odometry snapshot of this tick: pose (position + orientation) + linear twist
+	StateSnapshot current_state_; // state snapshot of this tick, check connect (onboard-pixhawk), arm, flight mode, ...
 	geometry_msgs::PoseStamped home_enu_pose_; // pose to store the starting pose (position + orientation) of drone
 	geometry_msgs::PoseStamped target_enu_pose_; // target pose to feed into the drone
 	geometry_msgs::Point opt_point_; // point (x,y,z) received from optimization planner
@@ -101,11 +111,19 @@ class OffboardControl
 	bool delivery_mode_enable_; // check enabled delivery mode or not
 	bool simulation_mode_enable_; // check enabled simulation mode or not
 	bool return_home_mode_enable_; // check enabled return home mode or not
+	std::string shm_ingest_name_; // shared-memory waypoint channel to read the mission from, empty = manual input
+	double shm_ingest_timeout_; // abort the mission if the plan stops arriving for this long (s)
+	bool sort_by_priority_; // fly higher-priority waypoints first (stable)
+	std::string voxel_map_path_; // occupancy map to plan legs between targets on, empty = fly straight legs
+	double planner_budget_ms_; // search time limit per leg
+	double robot_radius_; // obstacles of the voxel map are inflated by this much (m)
+	int planner_threads_; // legs planned concurrently
+	bool fly_through_enable_; // pass non-delivery waypoints without stopping
+	double lookahead_distance_; // pure pursuit lookahead along the queued waypoints (m)
+	double acceptance_time_; // acceptance radius at blended corners = speed * acceptance_time_, at least target_error_ and at most lookahead_distance_
 	
 	int num_of_enu_target_; // number of ENU (x,y,z) setpoints
 	std::stack<int> myStack;
-	std::vector<geometry_msgs::PoseStamped> targets;
-	std::vector<double> yaw_target_; // array of yaw targets of all setpoints
 	// double yaw_rate_;
 	bool odom_error_;
 	
@@ -129,6 +147,8 @@ class OffboardControl
 	void stateCallback(const mavros_msgs::State::ConstPtr& msg); // state callback
 	void odomCallback(const nav_msgs::Odometry::ConstPtr& msg); // odometry callback
 	void poseCallback(const geometry_msgs::PoseStamped::ConstPtr & msg); // call back the current position
+	void loadSnapshot(); // take one consistent odometry + state snapshot for the current tick
+	void publishOdomError(); // publish one full odometry message on odom_error
 
 	inline double radianOf(double deg) // convert from degree to radian
 	{
@@ -141,6 +161,8 @@ class OffboardControl
         return x*x;
     }; 
 
+	bool ingestSharedMemoryPlan(WaypointStore &mission, double hz); // wait for a plan on the shared-memory channel and read it into mission
+	bool planMissionLegs(WaypointStore &mission); // insert collision-free via-points between consecutive targets, false if a leg is blocked
 	void inputENUYawAndLandingSetpoint(); // manage input for ENU setpoint & Yaw angle & Landing at each setpoint to drop the package
 	void takeOff(geometry_msgs::PoseStamped setpoint, double hover_time); // perform takeoff task
 	void hovering(geometry_msgs::PoseStamped setpoint, double hover_time); // perform hover task
@@ -156,6 +178,8 @@ class OffboardControl
 	double distanceBetween(geometry_msgs::PoseStamped current, geometry_msgs::PoseStamped target); // calculate distance between current position and setpoint position
 	geometry_msgs::Vector3 velComponentsCalc(double v_desired, geometry_msgs::PoseStamped current, geometry_msgs::PoseStamped target); // calculate components of velocity about x, y, z axis
 
+	bool flyThrough(ArrayQueue &q, int idx, geometry_msgs::PoseStamped prev); // pass a transit waypoint without stopping
+
 	void dequeueFlight();
 	// void fillTheStack(int size, );
 	void pushIdxToStack(std::stack<int> &stack);
@@ -0,0 +1,32 @@
+#ifndef PURSUIT_H_
+#define PURSUIT_H_
+
+#include<offboard/waypoint_store.h>
+
+#include<eigen3/Eigen/Dense>
+#include<functional>
+#include<vector>
+
+/* geometry of the fly-through mode, no ROS
+   the path ahead is a polyline: path[0] = start of the current leg, path[1] = current waypoint, then queued waypoints
+   blend[i] (i >= 1) is set where the carrot may continue past path[i]; elsewhere the vehicle flies through the vertex itself */
+
+/* collect the path ahead: start, waypoint idx of store, then next_slot(0), next_slot(1), ... (-1 after the last queued one)
+   up to lookahead meters past the current waypoint or the first vertex that does not blend
+   a vertex blends if it is a transit waypoint (no WP_DELIVERY, no WP_VIA) with a successor, corners are allowed
+   (false when legs come from the voxel planner, cutting them could leave the collision-free corridor) and the turn is at most 90 degrees */
+void pathAhead(const Eigen::Vector3d &start, const WaypointStore &store, int idx, const std::function<int(int)> &next_slot,
+               bool allow_corners, double lookahead, std::vector<Eigen::Vector3d> &path, std::vector<char> &blend);
+
+/* arc length from path[0] to the projection of pos on the current leg, clamped to the leg */
+double legProgress(const Eigen::Vector3d &pos, const std::vector<Eigen::Vector3d> &path);
+
+/* carrot lookahead meters of arc length past legProgress(), stopping at the first vertex that does not blend
+   strictly ahead of the projection until the projection reaches the current waypoint */
+Eigen::Vector3d lookaheadAlong(const Eigen::Vector3d &pos, const std::vector<Eigen::Vector3d> &path, const std::vector<char> &blend, double lookahead);
+
+/* pos is past the current waypoint: beyond the bisector plane of the corner if it blends,
+   else beyond the plane through the waypoint perpendicular to the current leg */
+bool waypointPassed(const Eigen::Vector3d &pos, const std::vector<Eigen::Vector3d> &path, const std::vector<char> &blend);
+
+#endif
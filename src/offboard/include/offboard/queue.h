@@ -2,17 +2,22 @@
 #define QUEUE_H_
 
 #include<ros/ros.h>
+#include<offboard/waypoint_store.h>
 
 class ArrayQueue {
     private:
-    int front, rear;
+    int front, rear, count;
     public:
     int cap;
     //int *qArr;
-    geometry_msgs::PoseStamped *qArr;
-    ArrayQueue(int n) {cap = n; front = 0; rear = 0; qArr = new geometry_msgs::PoseStamped[cap];}
-    void enQueue(geometry_msgs::PoseStamped x);
+    WaypointStore qArr; // ring slots, stored column-wise
+    ArrayQueue(int n) {cap = n; front = 0; rear = 0; count = 0; qArr.resize(cap);}
+    explicit ArrayQueue(WaypointStore &&store); // queue every waypoint of store in order, takes the columns without copying
+    void enQueue(float x, float y, float z, float yaw, float hover, uint8_t flags, uint8_t priority);
     geometry_msgs::PoseStamped deQueue();
+    int deQueueIdx(); // slot in qArr of the dequeued waypoint, -1 if empty
+    int peekIdx(int k); // slot in qArr of the k-th waypoint after front, -1 if there is none
+    int size();
     void printQueue();
     bool isFull();
     bool isEmpty();
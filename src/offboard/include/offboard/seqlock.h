@@ -0,0 +1,66 @@
+#ifndef SEQLOCK_H_
+#define SEQLOCK_H_
+
+#include<atomic>
+#include<cstddef>
+#include<cstdint>
+#include<cstring>
+#include<type_traits>
+
+/* single-writer sequence lock holding a small trivially copyable snapshot
+   store(): wait-free, called from the subscriber callback (any spinner thread)
+   load(): retries until it copies a snapshot no store() overlapped, never sees a torn value
+   one writer per SeqLock - roscpp already serializes callbacks of a single subscription */
+template <class T>
+class SeqLock {
+    static_assert(std::is_trivially_copyable<T>::value, "SeqLock needs a trivially copyable type");
+
+    private:
+    static constexpr std::size_t WORDS = (sizeof(T) + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t);
+    std::atomic<std::uint32_t> seq_; // odd while a store() is in progress
+    std::atomic<std::uint64_t> data_[WORDS]; // payload kept in atomic words so racing copies are well defined
+
+    public:
+    SeqLock() : seq_(0) {
+        for (std::size_t i = 0; i < WORDS; i++) {
+            data_[i].store(0, std::memory_order_relaxed);
+        }
+    }
+    SeqLock(const SeqLock &) = delete;
+    SeqLock &operator=(const SeqLock &) = delete;
+
+    void store(const T &value) {
+        std::uint64_t buf[WORDS] = {};
+        std::memcpy(buf, &value, sizeof(T));
+        std::uint32_t s = seq_.load(std::memory_order_relaxed);
+        seq_.store(s + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (std::size_t i = 0; i < WORDS; i++) {
+            data_[i].store(buf[i], std::memory_order_relaxed);
+        }
+        seq_.store(s + 2, std::memory_order_release);
+    }
+
+    T load() const {
+        std::uint64_t buf[WORDS];
+        std::uint32_t s1, s2;
+        do {
+            s1 = seq_.load(std::memory_order_acquire);
+            for (std::size_t i = 0; i < WORDS; i++) {
+                buf[i] = data_[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            s2 = seq_.load(std::memory_order_relaxed);
+        } while ((s1 & 1) || s1 != s2);
+        T value;
+        std::memcpy(&value, buf, sizeof(T));
+        return value;
+    }
+
+    // number of completed stores, use to tell whether anything was published yet
+    std::uint32_t version() const {
+        return seq_.load(std::memory_order_acquire) / 2;
+    }
+};
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef SHM_WAYPOINT_H_
+#define SHM_WAYPOINT_H_
+
+/* shared-memory waypoint channel between a co-located planner (producer) and offboard_node (consumer)
+   one POSIX shm segment = versioned header + single-producer/single-consumer lock-free ring of
+   fixed-size records, no serialization and no locks on either side
+   a plan is announced with shm_wp_begin_plan(), then streamed with shm_wp_write()
+
+   segment lifetime: shm_wp_create() never reuses a segment, it unlinks the name and creates a fresh
+   one (O_EXCL). A consumer still mapping the old segment keeps a valid mapping that is never resized
+   or reset under it; shm_wp_stale() tells it to close and shm_wp_open() the new one
+   the segment is created with mode 0660: producer and consumer must share the user or group
+
+   records are not validated here, the consumer must check them before use */
+
+#include<stddef.h>
+#include<stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SHM_WP_MAGIC 0x50574853u // "SHWP"
+#define SHM_WP_VERSION 2u // bump on any change of the header or record layout
+#define SHM_WP_DEFAULT_CAPACITY (1u << 17) // records in the ring, 4 MiB
+
+/* return values of shm_wp_plan_info() */
+#define SHM_WP_NO_PLAN 0 // nothing announced yet
+#define SHM_WP_PLAN_PENDING 1 // announced, none of its records read yet
+#define SHM_WP_PLAN_CONSUMED 2 // announced, but a consumer already read (some of) its records
+
+/* flags of shm_wp_record, same bits as WaypointFlag */
+#define SHM_WP_DELIVERY 0x01u
+#define SHM_WP_VIA 0x02u
+
+typedef struct {
+    float x, y, z; // position (ENU, meter)
+    float yaw; // heading (radian)
+    float hover; // hover time when reached (second)
+    uint8_t flags; // SHM_WP_* bits
+    uint8_t priority;
+    uint16_t reserved;
+    uint32_t plan_id; // plan this record belongs to
+    uint32_t index; // position of the record in its plan
+} shm_wp_record; // 32 bytes
+
+typedef struct shm_wp_channel shm_wp_channel; // opaque handle
+
+/* producer: unlink any segment of that name and create a fresh one, capacity is rounded up to a power of two, NULL on error */
+shm_wp_channel *shm_wp_create(const char *name, uint32_t capacity);
+/* consumer: attach to an existing segment, NULL if missing, not initialized yet, of another version or with a capacity that is not a power of two */
+shm_wp_channel *shm_wp_open(const char *name);
+/* detach, the segment itself stays until shm_wp_unlink() */
+void shm_wp_close(shm_wp_channel *ch);
+int shm_wp_unlink(const char *name);
+/* consumer: 1 if the segment was unlinked or replaced by a newer shm_wp_create() since it was opened */
+int shm_wp_stale(shm_wp_channel *ch);
+
+/* producer: announce plan_id with num_points records, call before writing its records, one plan at a time */
+void shm_wp_begin_plan(shm_wp_channel *ch, uint32_t plan_id, uint32_t num_points);
+/* producer: copy up to n records into the ring without blocking, returns how many were written */
+size_t shm_wp_write(shm_wp_channel *ch, const shm_wp_record *records, size_t n);
+
+/* consumer: latest announced plan, returns one of SHM_WP_NO_PLAN, SHM_WP_PLAN_PENDING, SHM_WP_PLAN_CONSUMED */
+int shm_wp_plan_info(shm_wp_channel *ch, uint32_t *plan_id, uint32_t *num_points);
+/* consumer: copy up to max records out of the ring without blocking, returns how many were read */
+size_t shm_wp_read(shm_wp_channel *ch, shm_wp_record *out, size_t max);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef VEHICLE_SNAPSHOT_H_
+#define VEHICLE_SNAPSHOT_H_
+
+#include<cstdint>
+#include<cstring>
+
+/* compact copy of the odometry fields the control loops use, published through a SeqLock */
+struct OdomSnapshot
+{
+	double stamp; // header stamp in seconds
+	double x, y, z; // position (ENU)
+	double qx, qy, qz, qw; // orientation
+	double vx, vy, vz; // linear velocity (child frame, as sent by mavros)
+};
+
+/* compact copy of the FCU state fields the control loops use, published through a SeqLock */
+struct StateSnapshot
+{
+	bool connected;
+	bool armed;
+	uint8_t system_status;
+	char mode[24]; // flight mode, truncated and always null terminated
+
+	inline bool modeIs(const char *name) const
+	{
+		return std::strncmp(mode, name, sizeof(mode)) == 0;
+	}
+};
+
+#endif
@@ -0,0 +1,89 @@
+#ifndef VOXEL_PLANNER_H_
+#define VOXEL_PLANNER_H_
+
+#include<offboard/waypoint_store.h>
+
+#include<cstddef>
+#include<cstdint>
+#include<mutex>
+#include<string>
+#include<unordered_map>
+#include<vector>
+
+/* static 3D occupancy map, one bit per voxel
+   file layout (little endian):
+     char magic[4] = "VOXM", uint32 version = 1, uint32 nx, ny, nz,
+     float resolution (m), float origin x, y, z (ENU position of the corner of voxel 0,0,0),
+     ceil(nx*ny*nz / 64) uint64 words, bit (x + nx*(y + ny*z)) set = occupied */
+class VoxelMap {
+    public:
+    int nx = 0, ny = 0, nz = 0;
+    float resolution = 1.0f;
+    float ox = 0.0f, oy = 0.0f, oz = 0.0f;
+    std::vector<uint64_t> bits;
+
+    bool load(const std::string &path); // false if the file is missing or malformed
+    bool save(const std::string &path) const;
+    void resize(int sx, int sy, int sz, float res, float x0, float y0, float z0); // empty map of the given shape
+    inline bool inside(int x, int y, int z) const
+    {
+        return x >= 0 && y >= 0 && z >= 0 && x < nx && y < ny && z < nz;
+    }
+    inline std::size_t index(int x, int y, int z) const
+    {
+        return static_cast<std::size_t>(x) + static_cast<std::size_t>(nx) * (static_cast<std::size_t>(y) + static_cast<std::size_t>(ny) * z);
+    }
+    inline bool occupied(int x, int y, int z) const // outside the map counts as occupied
+    {
+        if (!inside(x, y, z)) {
+            return true;
+        }
+        std::size_t i = index(x, y, z);
+        return (bits[i >> 6] >> (i & 63)) & 1;
+    }
+    void setOccupied(int x, int y, int z, bool value);
+    void fillBox(float x0, float y0, float z0, float x1, float y1, float z1); // mark every voxel touching the box, clipped to the map
+    void inflate(float radius); // grow obstacles by radius (m) so the vehicle can be planned as a point
+    bool toVoxel(float x, float y, float z, int &vx, int &vy, int &vz) const; // false if outside the map
+    void toWorld(int vx, int vy, int vz, float &x, float &y, float &z) const; // center of the voxel
+    bool lineFree(float x0, float y0, float z0, float x1, float y1, float z1) const; // no occupied voxel along the segment
+};
+
+struct PlannerStats {
+    std::size_t legs = 0; // legs checked
+    std::size_t planned = 0; // legs that needed via-points
+    std::size_t failed = 0; // legs without a path: end outside the map or occupied, or none found by the retry
+    std::size_t cached = 0; // legs answered from the cache
+    double max_ms = 0.0; // slowest search
+};
+
+/* collision-free legs between consecutive targets on a VoxelMap
+   weighted A* on the 26-connected grid (no corner cutting) inside the bounding box of the leg plus a margin,
+   path shortened by line of sight to sparse via-points
+   legs are independent and planned concurrently, results are cached per (start voxel, goal voxel) */
+class VoxelPlanner {
+    public:
+    VoxelPlanner(const VoxelMap &map, double budget_ms, int margin = 8);
+    // via-points strictly between from and to, empty if the straight line is free; false if no path was found
+    // retry: search a box grown up to the buffer cap with 4x the budget, instead of the leg box plus margin
+    bool planLeg(float fx, float fy, float fz, float tx, float ty, float tz, std::vector<float> &via, PlannerStats &stats, bool retry = false);
+    // insert WP_VIA waypoints in front of every waypoint of mission, first leg starts at (sx, sy, sz)
+    // legs are planned on threads, failed ones are retried afterwards on the calling thread, search buffers are freed at the end
+    PlannerStats planMission(WaypointStore &mission, float sx, float sy, float sz, unsigned threads);
+
+    private:
+    struct Leg {
+        bool ok;
+        std::vector<float> via; // x, y, z triples
+    };
+    const VoxelMap &map_;
+    double budget_ms_; // give up the first search of a leg after this long, a retry gets 4x
+    int margin_; // voxels added around the bounding box of a leg
+    std::mutex cache_mutex_;
+    std::unordered_map<uint64_t, Leg> cache_;
+
+    std::size_t boxVoxels(int sx, int sy, int sz, int gx, int gy, int gz, int margin) const; // voxels in the search box
+    bool search(int sx, int sy, int sz, int gx, int gy, int gz, int margin, double budget_ms, std::vector<int> &path, double &elapsed_ms);
+};
+
+#endif
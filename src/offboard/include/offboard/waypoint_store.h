@@ -0,0 +1,39 @@
+#ifndef WAYPOINT_STORE_H_
+#define WAYPOINT_STORE_H_
+
+#include<geometry_msgs/PoseStamped.h>
+
+#include<cstddef>
+#include<cstdint>
+#include<vector>
+
+/* bits of WaypointStore::flags */
+enum WaypointFlag : uint8_t {
+    WP_DELIVERY = 1 << 0, // land and unpack at this waypoint
+    WP_VIA = 1 << 1, // inserted between operator targets (e.g. by a planner)
+};
+
+/* structure-of-arrays waypoint storage, one column per field (22 bytes per waypoint)
+   scans touch only the columns they need, reordering moves plain floats
+   convert to PoseStamped with toPose() only when the setpoint is published */
+class WaypointStore {
+    public:
+    std::vector<float> x, y, z; // position (ENU, meter)
+    std::vector<float> yaw; // heading (radian)
+    std::vector<float> hover; // hover time when reached (second)
+    std::vector<uint8_t> flags; // WaypointFlag bits
+    std::vector<uint8_t> priority; // higher goes first in sortByPriority()
+
+    std::size_t size() const {return x.size();}
+    void reserve(std::size_t n);
+    void resize(std::size_t n);
+    void clear();
+    void push(float px, float py, float pz, float pyaw, float phover, uint8_t pflags, uint8_t ppriority);
+    void set(std::size_t i, float px, float py, float pz, float pyaw, float phover, uint8_t pflags, uint8_t ppriority);
+    geometry_msgs::PoseStamped toPose(std::size_t i) const;
+    void permute(const std::vector<uint32_t> &order); // waypoint i becomes old waypoint order[i]
+    void sortByPriority(); // stable, highest priority first
+    std::size_t memoryBytes() const; // heap bytes held by the columns
+};
+
+#endif
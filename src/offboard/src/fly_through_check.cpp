@@ -0,0 +1,103 @@
+/* closed-loop check of the fly-through geometry (pursuit.h) on corners from 0 to 180 degrees and on a via-point
+   the vehicle tracks the published setpoint like a first-order position loop (1 s time constant), 10 Hz as in flyThrough()
+   every case runs with the given acceptance time and with 0, where the acceptance radius is only target_error
+   (a slowed-down vehicle), so only the plane tests can switch the waypoint
+   usage: rosrun offboard fly_through_check [lookahead (m)] [velocity (m/s)] [acceptance time (s)]
+   exit code 1 if a case does not finish within 120 s or a via-point corner is cut */
+#include "offboard/pursuit.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <initializer_list>
+
+struct Result {
+    bool finished;
+    double time; // seconds until the last waypoint is reached
+    double closest; // closest approach to the corner waypoint
+    double deviation; // largest distance from the polyline
+};
+
+static double segmentDistance(const Eigen::Vector3d &p, const Eigen::Vector3d &a, const Eigen::Vector3d &b) {
+    Eigen::Vector3d ab = b - a;
+    double t = (ab.squaredNorm() > 1e-12) ? std::min(1.0, std::max(0.0, (p - a).dot(ab) / ab.squaredNorm())) : 0.0;
+    return (a + t * ab - p).norm();
+}
+
+/* fly start -> corner (transit) -> end (final, precise arrival) the way dequeueFlight() does with fly-through on */
+static Result fly(const Eigen::Vector3d &start, const Eigen::Vector3d &corner, const Eigen::Vector3d &end, uint8_t corner_flags,
+                  double lookahead, double velocity, double acceptance_time) {
+    const double dt = 0.1, tau = 1.0, target_error = 0.1, timeout = 120.0;
+    WaypointStore store;
+    store.push(corner.x(), corner.y(), corner.z(), 0.0f, 0.0f, corner_flags, 0);
+    store.push(end.x(), end.y(), end.z(), 0.0f, 0.0f, 0, 0);
+    Eigen::Vector3d pos = start, vel = Eigen::Vector3d::Zero();
+    Result result = {false, 0.0, 1e9, 0.0};
+    auto step = [&](const Eigen::Vector3d &setpoint) {
+        vel = (setpoint - pos) / tau;
+        pos += vel * dt;
+        result.time += dt;
+        result.closest = std::min(result.closest, (pos - corner).norm());
+        result.deviation = std::max(result.deviation, std::min(segmentDistance(pos, start, corner), segmentDistance(pos, corner, end)));
+    };
+    auto toward = [&](const Eigen::Vector3d &target) {
+        Eigen::Vector3d d = target - pos;
+        return (d.norm() > 1e-3) ? Eigen::Vector3d(pos + d.normalized() * velocity) : target;
+    };
+
+    // transit waypoint, same decisions as flyThrough()
+    std::vector<Eigen::Vector3d> path;
+    std::vector<char> blend;
+    pathAhead(start, store, 0, [](int k) { return (k == 0) ? 1 : -1; }, true, lookahead, path, blend);
+    while (result.time < timeout) {
+        double radius = blend[1] ? std::min(lookahead, std::max(target_error, acceptance_time * vel.norm())) : target_error;
+        if ((path[1] - pos).norm() < radius || waypointPassed(pos, path, blend)) {
+            break;
+        }
+        step(toward(lookaheadAlong(pos, path, blend, lookahead)));
+    }
+    // final waypoint: the position loop settles on it once it is within one setpoint lead
+    while (result.time < timeout) {
+        if ((end - pos).norm() < target_error) {
+            result.finished = true;
+            break;
+        }
+        step(((end - pos).norm() > velocity) ? toward(end) : end);
+    }
+    return result;
+}
+
+int main(int argc, char **argv)
+{
+    double lookahead = (argc > 1) ? std::atof(argv[1]) : 3.0;
+    double velocity = (argc > 2) ? std::atof(argv[2]) : 2.0;
+    double acceptance = (argc > 3) ? std::atof(argv[3]) : 1.0;
+    const double pi = 3.14159265358979;
+    const Eigen::Vector3d start(0.0, 0.0, 5.0), corner(10.0, 0.0, 5.0);
+    bool ok = true;
+
+    for (double acceptance_time : {acceptance, 0.0}) {
+        std::printf("[ INFO] lookahead %.1f (m), velocity %.1f (m/s), acceptance time %.1f (s)\n", lookahead, velocity, acceptance_time);
+        const double turns[] = {0.0, 45.0, 90.0, 95.0, 100.0, 120.0, 150.0, 180.0};
+        for (double turn : turns) {
+            Eigen::Vector3d end = corner + 10.0 * Eigen::Vector3d(std::cos(turn * pi / 180.0), std::sin(turn * pi / 180.0), 0.0);
+            Result r = fly(start, corner, end, 0, lookahead, velocity, acceptance_time);
+            std::printf("[ %s] turn %5.1f (deg): %s in %5.1f (s), closest %.2f (m), off path %.2f (m)\n", r.finished ? "INFO" : "ERROR",
+                        turn, r.finished ? "done" : "stalled", r.time, r.closest, r.deviation);
+            ok = ok && r.finished;
+        }
+
+        // hairpin of a manual route with delivery off: (0,0,5) -> (10,0,5) -> (0,0,5)
+        Result hairpin = fly(start, corner, start, 0, lookahead, velocity, acceptance_time);
+        std::printf("[ %s] hairpin back to the start: %s in %.1f (s)\n", hairpin.finished ? "INFO" : "ERROR", hairpin.finished ? "done" : "stalled", hairpin.time);
+        ok = ok && hairpin.finished;
+
+        // planner via-point: the corner must not be cut
+        Result via = fly(start, corner, corner + Eigen::Vector3d(0.0, 10.0, 0.0), WP_VIA, lookahead, velocity, acceptance_time);
+        bool kept = via.finished && via.deviation < 0.5;
+        std::printf("[ %s] 90 (deg) at a via-point: %s in %.1f (s), closest %.2f (m), off path %.2f (m)\n", kept ? "INFO" : "ERROR",
+                    via.finished ? "done" : "stalled", via.time, via.closest, via.deviation);
+        ok = ok && kept;
+    }
+    return ok ? 0 : 1;
+}
@@ -1,6 +1,11 @@
 #include "offboard/offboard.h"
 #include "offboard/queue.h"
+#include "offboard/pursuit.h"
+#include "offboard/shm_waypoint.h"
+#include "offboard/voxel_planner.h"
 #include <stack>
+#include <algorithm>
+#include <thread>
 
 //constructor of Offboard class
 OffboardControl::OffboardControl(const ros::NodeHandle &nh, const ros::NodeHandle &nh_private, bool input_setpoint) : nh_(nh),
@@ -15,6 +20,17 @@ OffboardControl::OffboardControl(const ros::NodeHandle &nh, const ros::NodeHandl
     nh_private_.param<bool>("/offboard_node/simulation_mode_enable", simulation_mode_enable_, simulation_mode_enable_);
     nh_private_.param<bool>("/offboard_node/delivery_mode_enable", delivery_mode_enable_, delivery_mode_enable_);
     nh_private_.param<bool>("/offboard_node/return_home_mode_enable", return_home_mode_enable_, return_home_mode_enable_);
+    nh_private_.param<std::string>("/offboard_node/shm_ingest_name", shm_ingest_name_, "");
+    nh_private_.param<double>("/offboard_node/shm_ingest_timeout", shm_ingest_timeout_, 1.0);
+    nh_private_.getParam("/offboard_node/target_error", target_error_);
+    nh_private_.param<bool>("/offboard_node/sort_by_priority", sort_by_priority_, false);
+    nh_private_.param<std::string>("/offboard_node/voxel_map", voxel_map_path_, "");
+    nh_private_.param<double>("/offboard_node/planner_budget_ms", planner_budget_ms_, 5.0);
+    nh_private_.param<double>("/offboard_node/robot_radius", robot_radius_, 0.5);
+    nh_private_.param<int>("/offboard_node/planner_threads", planner_threads_, std::thread::hardware_concurrency());
+    nh_private_.param<bool>("/offboard_node/fly_through_enable", fly_through_enable_, false);
+    nh_private_.param<double>("/offboard_node/lookahead_distance", lookahead_distance_, 3.0);
+    nh_private_.param<double>("/offboard_node/acceptance_time", acceptance_time_, 1.0);
     nh_private_.getParam("/offboard_node/z_takeoff", z_takeoff_);
     nh_private_.getParam("/offboard_node/z_delivery", z_delivery_);
     nh_private_.getParam("/offboard_node/land_error", land_error_);
@@ -23,6 +39,7 @@ OffboardControl::OffboardControl(const ros::NodeHandle &nh, const ros::NodeHandl
     nh_private_.getParam("/offboard_node/desired_velocity", vel_desired_);
     nh_private_.getParam("/offboard_node/odom_error", odom_error_);
 
+    loadSnapshot();
     waitForPredicate(10.0);
     dequeueFlight();
 }
@@ -40,6 +57,7 @@ void OffboardControl::waitForPredicate(double hz) {
     std::printf("\n[ INFO] Waiting for FCU connection \n");
     while (ros::ok() && !current_state_.connected) {
         ros::spinOnce();
+        loadSnapshot();
         rate.sleep();
     }
     std::printf("[ INFO] FCU connected \n");
@@ -64,7 +82,7 @@ void OffboardControl::waitForPredicate(double hz) {
 /* send a few setpoints before publish
    input: ros rate in hertz (at least 2Hz) and first setpoint */
 void OffboardControl::setOffboardStream(double hz, geometry_msgs::PoseStamped first_target) {
-    home_enu_pose_ = targetTransfer(current_odom_.pose.pose.position.x, current_odom_.pose.pose.position.y, current_odom_.pose.pose.position.z);
+    home_enu_pose_ = targetTransfer(current_odom_.x, current_odom_.y, current_odom_.z);
     ros::Rate rate(hz);
     std::printf("[ INFO] Setting OFFBOARD stream \n");
     for (int i = 50; ros::ok() && i > 0; --i) {
@@ -72,6 +90,7 @@ void OffboardControl::setOffboardStream(double hz, geometry_msgs::PoseStamped fi
         target_enu_pose_.header.stamp = ros::Time::now();
         setpoint_pose_pub_.publish(target_enu_pose_);
         ros::spinOnce();
+        loadSnapshot();
         rate.sleep();
     }
     std::printf("\n[ INFO] OFFBOARD stream is set\n");
@@ -83,7 +102,7 @@ void OffboardControl::waitForArmAndOffboard(double hz) {
     ros::Rate rate(hz);
     if (simulation_mode_enable_) {
         std::printf("\n[ INFO] Ready to takeoff\n");
-        while (ros::ok() && !current_state_.armed && (current_state_.mode != "OFFBOARD")) {
+        while (ros::ok() && !current_state_.armed && (!current_state_.modeIs("OFFBOARD"))) {
             mavros_msgs::CommandBool arm_amd;
             arm_amd.request.value = true;
             if (arming_client_.call(arm_amd) && arm_amd.response.success) {
@@ -103,32 +122,71 @@ void OffboardControl::waitForArmAndOffboard(double hz) {
                 ROS_INFO_ONCE("Failed to set OFFBOARD");
             }
             ros::spinOnce();
+            loadSnapshot();
             rate.sleep();
         }
         //DuyNguyen
         if (odom_error_) {
-            odom_error_pub_.publish(current_odom_);
+            publishOdomError();
         }
     }
     else {
         std::printf("\n[ INFO] Waiting switching (ARM and OFFBOARD mode) from RC\n");
-        while (ros::ok() && !current_state_.armed && (current_state_.mode != "OFFBOARD")) {
+        while (ros::ok() && !current_state_.armed && (!current_state_.modeIs("OFFBOARD"))) {
             ros::spinOnce();
+            loadSnapshot();
             rate.sleep();
         }
         //DuyNguyen
         if (odom_error_) {
-            odom_error_pub_.publish(current_odom_);
+            publishOdomError();
         }
     }
 }
 
+/* callbacks only store into the seqlocks (wait-free for the writer), safe to run on any spinner thread
+   the control loops read current_odom_ / current_state_, refreshed by loadSnapshot() once per tick */
 void OffboardControl::stateCallback(const mavros_msgs::State::ConstPtr &msg) {
-    current_state_ = *msg;
+    StateSnapshot state;
+    state.connected = msg->connected;
+    state.armed = msg->armed;
+    state.system_status = msg->system_status;
+    std::strncpy(state.mode, msg->mode.c_str(), sizeof(state.mode) - 1);
+    state.mode[sizeof(state.mode) - 1] = '\0';
+    state_buf_.store(state);
 }
 
 void OffboardControl::odomCallback(const nav_msgs::Odometry::ConstPtr &msg) {
-    current_odom_ = *msg;
+    OdomSnapshot odom;
+    odom.stamp = msg->header.stamp.toSec();
+    odom.x = msg->pose.pose.position.x;
+    odom.y = msg->pose.pose.position.y;
+    odom.z = msg->pose.pose.position.z;
+    odom.qx = msg->pose.pose.orientation.x;
+    odom.qy = msg->pose.pose.orientation.y;
+    odom.qz = msg->pose.pose.orientation.z;
+    odom.qw = msg->pose.pose.orientation.w;
+    odom.vx = msg->twist.twist.linear.x;
+    odom.vy = msg->twist.twist.linear.y;
+    odom.vz = msg->twist.twist.linear.z;
+    odom_buf_.store(odom);
+}
+
+void OffboardControl::loadSnapshot() {
+    current_odom_ = odom_buf_.load();
+    current_state_ = state_buf_.load();
+}
+
+/* publish a full odometry message (frame ids, covariance, angular twist) on the latched odom_error topic
+   taken once from the odometry topic here, so odomCallback does not keep a copy of every message */
+void OffboardControl::publishOdomError() {
+    nav_msgs::Odometry::ConstPtr msg = ros::topic::waitForMessage<nav_msgs::Odometry>("/mavros/local_position/odom", nh_, ros::Duration(1.0));
+    if (msg) {
+        odom_error_pub_.publish(*msg);
+    }
+    else {
+        std::printf("[ WARN] No odometry within 1 (s), odom_error not published\n");
+    }
 }
 
 void OffboardControl::dequeueFlight() {
@@ -137,76 +195,120 @@ void OffboardControl::dequeueFlight() {
     int i = 0;
     geometry_msgs::PoseStamped setpoint;
     double x, y, z, yaw;
-    std::printf("[ INFO] Manual enter ENU target position(s) to drop packages\n");
-    std::printf(" Number of target(s): ");
-    std::cin >> num_of_enu_target_;
-    ArrayQueue q1(num_of_enu_target_);
-    std::cout << "Start to enqueue each setpoint to the queue..." << std::endl;
-    for (int i = 0; i < num_of_enu_target_; i++) {
-        std::printf(" Target (%d) postion x, y, z (in meter): ", i + 1);
-        std::cin >> x >> y >> z;
-        geometry_msgs::PoseStamped point_to_push;
-        point_to_push.pose.position.x = x;
-        point_to_push.pose.position.y = y;
-        point_to_push.pose.position.z = z;
-        q1.enQueue(point_to_push);
-        ros::spinOnce();
-        rate.sleep();
+    int idx;
+    WaypointStore mission;
+    if (!shm_ingest_name_.empty()) {
+        if (!ingestSharedMemoryPlan(mission, 100.0)) {
+            std::printf("[ ERROR] No complete plan from shared memory, mission aborted before takeoff\n");
+            ros::shutdown();
+            return;
+        }
+        num_of_enu_target_ = mission.size();
     }
+    else {
+        std::printf("[ INFO] Manual enter ENU target position(s) to drop packages\n");
+        std::printf(" Number of target(s): ");
+        std::cin >> num_of_enu_target_;
+        mission.reserve(num_of_enu_target_);
+        std::cout << "Start to enqueue each setpoint to the queue..." << std::endl;
+        for (int i = 0; i < num_of_enu_target_; i++) {
+            std::printf(" Target (%d) postion x, y, z (in meter): ", i + 1);
+            std::cin >> x >> y >> z;
+            mission.push(x, y, z, 0.0, hover_time_, delivery_mode_enable_ ? WP_DELIVERY : 0, 0);
+            ros::spinOnce();
+            loadSnapshot();
+            rate.sleep();
+        }
+    }
+    if (mission.size() == 0) {
+        std::printf("[ ERROR] Empty mission, aborted before takeoff\n");
+        ros::shutdown();
+        return;
+    }
+    if (sort_by_priority_) {
+        mission.sortByPriority(); // before planning, legs follow the flown order
+    }
+    if (!voxel_map_path_.empty()) {
+        if (!planMissionLegs(mission)) {
+            std::printf("[ ERROR] No collision-free mission on the voxel map, mission aborted before takeoff\n");
+            ros::shutdown();
+            return;
+        }
+    }
+    std::printf("[ INFO] Mission: %zu waypoint(s), %.1f (KiB)\n", mission.size(), mission.memoryBytes() / 1024.0);
+    ArrayQueue q1(std::move(mission));
     std::cout << "Enqueue completed!" << std::endl;
-    q1.printQueue();
-    std::printf(" Error to check target reached (in meter): ");
-    std::cin >> target_error_;
-    pushIdxToStack(myStack);
-    setOffboardStream(10.0, targetTransfer(current_odom_.pose.pose.position.x, current_odom_.pose.pose.position.y, z_takeoff_));
+    if (q1.size() <= 100) {
+        q1.printQueue();
+    }
+    if (shm_ingest_name_.empty()) {
+        std::printf(" Error to check target reached (in meter): ");
+        std::cin >> target_error_;
+        pushIdxToStack(myStack);
+    }
+    else {
+        // plan index of every delivery point, first delivery on top
+        for (int k = q1.size() - 1; k >= 0; k--) {
+            if (q1.qArr.flags[q1.peekIdx(k)] & WP_DELIVERY) {
+                myStack.push(k);
+            }
+        }
+    }
+    setOffboardStream(10.0, targetTransfer(current_odom_.x, current_odom_.y, z_takeoff_));
     waitForArmAndOffboard(10.0);
-    takeOff(targetTransfer(current_odom_.pose.pose.position.x, current_odom_.pose.pose.position.y, z_takeoff_), hover_time_);
+    geometry_msgs::PoseStamped prev = targetTransfer(current_odom_.x, current_odom_.y, z_takeoff_); // start of the current leg
+    takeOff(prev, hover_time_);
     std::printf("\n[ INFO] Flight with ENU setpoint and Yaw angle\n");
     while (ros::ok() && target_reached) {
         std::cout << "Dequeueing point " << i+1 << std::endl;
         target_reached = false;
-        if (i < (num_of_enu_target_ - 1)) {
-            final_position_reached_ = false;
-            // setpoint = targetTransfer(x_target_[i], y_target_[i], z_target_[i]);
-            setpoint = q1.deQueue();
-        }
-        else {
-            final_position_reached_ = true;
-            // setpoint = targetTransfer(x_target_[num_of_enu_target_ - 1], y_target_[num_of_enu_target_ - 1], z_target_[num_of_enu_target_ - 1]);
-            setpoint = q1.deQueue(); //try it
+        final_position_reached_ = (q1.size() <= 1);
+        idx = q1.deQueueIdx();
+        if (idx < 0) {
+            break;
         }
+        setpoint = q1.qArr.toPose(idx);
+        double hover_time = q1.qArr.hover[idx];
+        bool delivery_point = q1.qArr.flags[idx] & WP_DELIVERY;
         std::cout << "Final position reached check: " << final_position_reached_ << std::endl;
+        if (fly_through_enable_ && !delivery_point && !final_position_reached_) {
+            target_reached = flyThrough(q1, idx, prev);
+            prev = setpoint;
+            i += 1;
+            continue;
+        }
         while(ros::ok()){
-            components_vel_ = velComponentsCalc(vel_desired_, targetTransfer(current_odom_.pose.pose.position.x, current_odom_.pose.pose.position.y, current_odom_.pose.pose.position.z), setpoint);
+            components_vel_ = velComponentsCalc(vel_desired_, targetTransfer(current_odom_.x, current_odom_.y, current_odom_.z), setpoint);
 
-            target_enu_pose_ = targetTransfer(current_odom_.pose.pose.position.x + components_vel_.x, current_odom_.pose.pose.position.y + components_vel_.y, current_odom_.pose.pose.position.z + components_vel_.z);
+            target_enu_pose_ = targetTransfer(current_odom_.x + components_vel_.x, current_odom_.y + components_vel_.y, current_odom_.z + components_vel_.z);
             target_enu_pose_.header.stamp = ros::Time::now();
             setpoint_pose_pub_.publish(target_enu_pose_);
 
-            distance_ = distanceBetween(targetTransfer(current_odom_.pose.pose.position.x, current_odom_.pose.pose.position.y, current_odom_.pose.pose.position.z), setpoint);
+            distance_ = distanceBetween(targetTransfer(current_odom_.x, current_odom_.y, current_odom_.z), setpoint);
             std::printf("Distance to target: %.1f (m) \n", distance_);
 
             target_reached = checkPositionError(target_error_, setpoint);
 
             if (target_reached && !final_position_reached_) {
-                std::printf("\n[ INFO] Reached position: [%.1f, %.1f, %.1f]\n", current_odom_.pose.pose.position.x, current_odom_.pose.pose.position.y, current_odom_.pose.pose.position.z);
+                std::printf("\n[ INFO] Reached position: [%.1f, %.1f, %.1f]\n", current_odom_.x, current_odom_.y, current_odom_.z);
 
-                hovering(setpoint, hover_time_);
-                if (delivery_mode_enable_)
+                hovering(setpoint, hover_time);
+                if (delivery_point)
                 {
                     delivery(setpoint, unpack_time_);
                 }
+                prev = setpoint;
                 i += 1;
                 break;
             }
             if (target_reached && final_position_reached_) {
-                std::printf("\n[ INFO] Reached Final position: [%.1f, %.1f, %.1f]\n", current_odom_.pose.pose.position.x, current_odom_.pose.pose.position.y, current_odom_.pose.pose.position.z);
-                hovering(setpoint, hover_time_);
+                std::printf("\n[ INFO] Reached Final position: [%.1f, %.1f, %.1f]\n", current_odom_.x, current_odom_.y, current_odom_.z);
+                hovering(setpoint, hover_time);
                 if (!return_home_mode_enable_) {
                     landing(targetTransfer(setpoint.pose.position.x, setpoint.pose.position.y, 0.0));
                 }
                 else {
-                    if (delivery_mode_enable_) {
+                    if (delivery_point) {
                         delivery(setpoint, unpack_time_);
                     }
                     std::printf("\n[ INFO] Returning home [%.1f, %.1f, %.1f]\n", home_enu_pose_.pose.position.x, home_enu_pose_.pose.position.y, home_enu_pose_.pose.position.z);
@@ -215,6 +317,7 @@ void OffboardControl::dequeueFlight() {
                 }
             }
             ros::spinOnce();
+            loadSnapshot();
             rate.sleep();
         }
     }
@@ -222,6 +325,147 @@ void OffboardControl::dequeueFlight() {
 }
 
 
+/* wait for a new plan on the shared-memory channel and read it straight into the mission store
+   plans already read by another consumer are skipped, a replaced segment is reopened
+   input: mission store to fill and ros rate in hertz while waiting for the producer
+   output: false if the plan did not arrive completely within shm_ingest_timeout_
+           or a record has a non-finite position, yaw or hover, or a negative hover */
+bool OffboardControl::ingestSharedMemoryPlan(WaypointStore &mission, double hz) {
+    ros::Rate rate(hz);
+    shm_wp_channel *ch = nullptr;
+    uint32_t plan_id = 0, num_points = 0;
+    int plan_state = SHM_WP_NO_PLAN;
+    std::printf("[ INFO] Waiting for a plan on shared memory '%s'\n", shm_ingest_name_.c_str());
+    while (ros::ok() && plan_state != SHM_WP_PLAN_PENDING) {
+        if (ch != nullptr && shm_wp_stale(ch)) {
+            shm_wp_close(ch); // producer restarted, its new segment is under the same name
+            ch = nullptr;
+        }
+        if (ch == nullptr) {
+            ch = shm_wp_open(shm_ingest_name_.c_str());
+        }
+        if (ch != nullptr) {
+            int state = shm_wp_plan_info(ch, &plan_id, &num_points);
+            if (state == SHM_WP_PLAN_CONSUMED && plan_state != SHM_WP_PLAN_CONSUMED) {
+                std::printf("[ WARN] Plan %u was already consumed, waiting for a new one\n", plan_id);
+            }
+            plan_state = state;
+        }
+        if (plan_state != SHM_WP_PLAN_PENDING) {
+            ros::spinOnce();
+            loadSnapshot();
+            rate.sleep();
+        }
+    }
+    if (ch == nullptr || plan_state != SHM_WP_PLAN_PENDING) {
+        shm_wp_close(ch);
+        return false;
+    }
+
+    ros::WallTime t_start = ros::WallTime::now();
+    ros::WallTime t_progress = t_start;
+    std::vector<shm_wp_record> batch(4096);
+    mission.reserve(num_points);
+    while (ros::ok() && mission.size() < num_points) {
+        size_t n = shm_wp_read(ch, batch.data(), batch.size());
+        for (size_t k = 0; k < n; k++) {
+            const shm_wp_record &wp = batch[k];
+            if (wp.plan_id != plan_id) {
+                continue; // left over from an older plan
+            }
+            if (!std::isfinite(wp.x) || !std::isfinite(wp.y) || !std::isfinite(wp.z) || !std::isfinite(wp.yaw)
+                || !std::isfinite(wp.hover) || wp.hover < 0.0f) {
+                std::printf("[ ERROR] Plan %u: invalid waypoint %u (%.2f, %.2f, %.2f) yaw %.2f hover %.2f, plan rejected\n", plan_id, wp.index, wp.x, wp.y, wp.z, wp.yaw, wp.hover);
+                shm_wp_close(ch);
+                return false;
+            }
+            if (mission.size() == num_points) {
+                break; // more records than announced, the rest belongs to nobody
+            }
+            uint8_t flags = delivery_mode_enable_ ? wp.flags : (wp.flags & ~WP_DELIVERY);
+            mission.push(wp.x, wp.y, wp.z, wp.yaw, wp.hover, flags, wp.priority);
+        }
+        if (n > 0) {
+            t_progress = ros::WallTime::now();
+        }
+        else if ((ros::WallTime::now() - t_progress).toSec() > shm_ingest_timeout_) {
+            std::printf("[ ERROR] Plan %u: %zu of %u waypoint(s) after %.1f (s) without progress\n", plan_id, mission.size(), num_points, shm_ingest_timeout_);
+            shm_wp_close(ch);
+            return false;
+        }
+        else {
+            std::this_thread::yield(); // producer still writing
+        }
+    }
+    shm_wp_close(ch);
+    if (mission.size() < num_points) {
+        return false;
+    }
+    std::printf("[ INFO] Plan %u: %zu waypoint(s) ingested in %.1f (us)\n", plan_id, mission.size(), (ros::WallTime::now() - t_start).toNSec() / 1e3);
+    return true;
+}
+
+/* insert collision-free via-points between consecutive targets, first leg starts at the takeoff point
+   input: mission store, replaced by the expanded one
+   output: false if the map cannot be loaded or a leg has no collision-free path */
+bool OffboardControl::planMissionLegs(WaypointStore &mission) {
+    VoxelMap map;
+    if (!map.load(voxel_map_path_)) {
+        std::printf("[ ERROR] Cannot load voxel map '%s'\n", voxel_map_path_.c_str());
+        return false;
+    }
+    map.inflate(robot_radius_); // once, A* and the line-of-sight checks then treat the vehicle as a point
+    std::printf("[ INFO] Planning legs on %dx%dx%d voxel map (%.2f m), obstacles inflated by %.2f (m)\n", map.nx, map.ny, map.nz, map.resolution, robot_radius_);
+    VoxelPlanner planner(map, planner_budget_ms_);
+    ros::WallTime t_start = ros::WallTime::now();
+    PlannerStats stats = planner.planMission(mission, current_odom_.x, current_odom_.y, z_takeoff_, std::max(1, planner_threads_));
+    std::printf("[ INFO] %zu leg(s): %zu detoured, %zu cached, slowest search %.2f (ms), total %.1f (ms)\n", stats.legs, stats.planned, stats.cached, stats.max_ms, (ros::WallTime::now() - t_start).toNSec() / 1e6);
+    if (stats.failed > 0) {
+        std::printf("[ ERROR] %zu leg(s) blocked: end point outside the map or occupied, or no path found\n", stats.failed);
+        return false;
+    }
+    return true;
+}
+
+/* pass a transit waypoint without stopping: chase the pure pursuit carrot along the queued waypoints (see pursuit.h)
+   corners of at most 90 degrees between plain transit waypoints are blended, the waypoint is passed inside a
+   speed-dependent acceptance radius or at the bisector plane; sharper turns, via-points and planned legs are flown
+   through the waypoint itself, passed within target_error_ or at the plane across the leg
+   input: queue, slot of the current (dequeued) waypoint and start of the current leg */
+bool OffboardControl::flyThrough(ArrayQueue &q, int idx, geometry_msgs::PoseStamped prev) {
+    ros::Rate rate(10.0);
+    Eigen::Vector3d start(prev.pose.position.x, prev.pose.position.y, prev.pose.position.z);
+    std::vector<Eigen::Vector3d> path;
+    std::vector<char> blend;
+    pathAhead(start, q.qArr, idx, [&q](int k) { return q.peekIdx(k); }, voxel_map_path_.empty(), lookahead_distance_, path, blend);
+    while (ros::ok()) {
+        Eigen::Vector3d pos(current_odom_.x, current_odom_.y, current_odom_.z);
+        double speed = std::sqrt(sqr(current_odom_.vx) + sqr(current_odom_.vy) + sqr(current_odom_.vz));
+        double radius = blend[1] ? std::min(lookahead_distance_, std::max(target_error_, acceptance_time_ * speed)) : target_error_;
+        distance_ = (path[1] - pos).norm();
+        if (distance_ < radius || waypointPassed(pos, path, blend)) {
+            std::printf("[ INFO] Passed waypoint [%.1f, %.1f, %.1f] at %.1f (m/s)\n", path[1].x(), path[1].y(), path[1].z(), speed);
+            return true;
+        }
+
+        Eigen::Vector3d carrot = lookaheadAlong(pos, path, blend, lookahead_distance_);
+        if ((carrot - pos).norm() > 1e-3) {
+            components_vel_ = velComponentsCalc(vel_desired_, targetTransfer(pos.x(), pos.y(), pos.z()), targetTransfer(carrot.x(), carrot.y(), carrot.z()));
+            target_enu_pose_ = targetTransfer(pos.x() + components_vel_.x, pos.y() + components_vel_.y, pos.z() + components_vel_.z);
+        }
+        else {
+            target_enu_pose_ = targetTransfer(carrot.x(), carrot.y(), carrot.z()); // off the path right on the carrot, it moves on next tick
+        }
+        target_enu_pose_.header.stamp = ros::Time::now();
+        setpoint_pose_pub_.publish(target_enu_pose_);
+
+        ros::spinOnce();
+        loadSnapshot();
+        rate.sleep();
+    }
+    return false;
+}
+
 /* calculate distance between current position and setpoint position
    input: current and target poses (ENU) to calculate distance */
 double OffboardControl::distanceBetween(geometry_msgs::PoseStamped current, geometry_msgs::PoseStamped target) {
@@ -270,9 +514,9 @@ void OffboardControl::takeOff(geometry_msgs::PoseStamped setpoint, double hover_
     std::printf("\n[ INFO] Takeoff to [%.1f, %.1f, %.1f]\n", setpoint.pose.position.x, setpoint.pose.position.y, setpoint.pose.position.z);
     bool takeoff_reached = false;
     while (ros::ok() && !takeoff_reached) {
-        components_vel_ = velComponentsCalc(vel_desired_, targetTransfer(current_odom_.pose.pose.position.x, current_odom_.pose.pose.position.y, current_odom_.pose.pose.position.z), setpoint);
+        components_vel_ = velComponentsCalc(vel_desired_, targetTransfer(current_odom_.x, current_odom_.y, current_odom_.z), setpoint);
 
-        target_enu_pose_ = targetTransfer(current_odom_.pose.pose.position.x + components_vel_.x, current_odom_.pose.pose.position.y + components_vel_.y, current_odom_.pose.pose.position.z + components_vel_.z);
+        target_enu_pose_ = targetTransfer(current_odom_.x + components_vel_.x, current_odom_.y + components_vel_.y, current_odom_.z + components_vel_.z);
         target_enu_pose_.header.stamp = ros::Time::now();
         setpoint_pose_pub_.publish(target_enu_pose_);
 
@@ -282,6 +526,7 @@ void OffboardControl::takeOff(geometry_msgs::PoseStamped setpoint, double hover_
         }
         else {
             ros::spinOnce();
+            loadSnapshot();
             rate.sleep();
         }
     }
@@ -309,6 +554,7 @@ void OffboardControl::hovering(geometry_msgs::PoseStamped setpoint, double hover
         setpoint_pose_pub_.publish(setpoint);
         // std::cout << "Hello World" <<std::endl;
         ros::spinOnce();
+        loadSnapshot();
         rate.sleep();
     }
 }
@@ -320,9 +566,9 @@ void OffboardControl::landing(geometry_msgs::PoseStamped setpoint) {
     bool land_reached = false;
     std::printf("[ INFO] Landing\n");
     while (ros::ok() && !land_reached) {
-        components_vel_ = velComponentsCalc(vel_desired_, targetTransfer(current_odom_.pose.pose.position.x, current_odom_.pose.pose.position.y, current_odom_.pose.pose.position.z), setpoint);
+        components_vel_ = velComponentsCalc(vel_desired_, targetTransfer(current_odom_.x, current_odom_.y, current_odom_.z), setpoint);
 
-        target_enu_pose_ = targetTransfer(current_odom_.pose.pose.position.x + components_vel_.x, current_odom_.pose.pose.position.y + components_vel_.y, current_odom_.pose.pose.position.z + components_vel_.z);
+        target_enu_pose_ = targetTransfer(current_odom_.x + components_vel_.x, current_odom_.y + components_vel_.y, current_odom_.z + components_vel_.z);
         target_enu_pose_.header.stamp = ros::Time::now();
         // target_enu_pose_.pose.orientation = setpoint.pose.orientation;
         setpoint_pose_pub_.publish(target_enu_pose_);
@@ -344,6 +590,7 @@ void OffboardControl::landing(geometry_msgs::PoseStamped setpoint) {
         }
         else {
             ros::spinOnce();
+            loadSnapshot();
             rate.sleep();
         }
     }
@@ -359,9 +606,9 @@ void OffboardControl::returnHome(geometry_msgs::PoseStamped home_pose) {
     ros::Rate rate(10.0);
     bool home_reached = false;
     while (ros::ok() && !home_reached) {
-        components_vel_ = velComponentsCalc(vel_desired_, targetTransfer(current_odom_.pose.pose.position.x, current_odom_.pose.pose.position.y, current_odom_.pose.pose.position.z), home_pose);
+        components_vel_ = velComponentsCalc(vel_desired_, targetTransfer(current_odom_.x, current_odom_.y, current_odom_.z), home_pose);
 
-        target_enu_pose_ = targetTransfer(current_odom_.pose.pose.position.x + components_vel_.x, current_odom_.pose.pose.position.y + components_vel_.y, current_odom_.pose.pose.position.z + components_vel_.z);
+        target_enu_pose_ = targetTransfer(current_odom_.x + components_vel_.x, current_odom_.y + components_vel_.y, current_odom_.z + components_vel_.z);
         target_enu_pose_.header.stamp = ros::Time::now();
         setpoint_pose_pub_.publish(target_enu_pose_);
 
@@ -371,6 +618,7 @@ void OffboardControl::returnHome(geometry_msgs::PoseStamped home_pose) {
         }
         else {
             ros::spinOnce();
+            loadSnapshot();
             rate.sleep();
         }
     }
@@ -383,9 +631,9 @@ void OffboardControl::delivery(geometry_msgs::PoseStamped setpoint, double unpac
     bool land_reached = false;
     std::printf("[ INFO] Land for unpacking\n");
     while (ros::ok() && !land_reached) {
-        components_vel_ = velComponentsCalc(vel_desired_, targetTransfer(current_odom_.pose.pose.position.x, current_odom_.pose.pose.position.y, current_odom_.pose.pose.position.z), targetTransfer(setpoint.pose.position.x, setpoint.pose.position.y, z_delivery_));
+        components_vel_ = velComponentsCalc(vel_desired_, targetTransfer(current_odom_.x, current_odom_.y, current_odom_.z), targetTransfer(setpoint.pose.position.x, setpoint.pose.position.y, z_delivery_));
 
-        target_enu_pose_ = targetTransfer(current_odom_.pose.pose.position.x + components_vel_.x, current_odom_.pose.pose.position.y + components_vel_.y, current_odom_.pose.pose.position.z + components_vel_.z);
+        target_enu_pose_ = targetTransfer(current_odom_.x + components_vel_.x, current_odom_.y + components_vel_.y, current_odom_.z + components_vel_.z);
         target_enu_pose_.header.stamp = ros::Time::now();
         setpoint_pose_pub_.publish(target_enu_pose_);
 
@@ -398,20 +646,23 @@ void OffboardControl::delivery(geometry_msgs::PoseStamped setpoint, double unpac
 
         if (land_reached) {
             if (current_state_.system_status == 3) {
-                hovering(targetTransfer(current_odom_.pose.pose.position.x, current_odom_.pose.pose.position.y, current_odom_.pose.pose.position.z), unpack_time);
+                hovering(targetTransfer(current_odom_.x, current_odom_.y, current_odom_.z), unpack_time);
                 // TODO: unpack service
             }
             else {
                 hovering(targetTransfer(setpoint.pose.position.x, setpoint.pose.position.y, z_delivery_), unpack_time);
                 // TODO: unpack service
             }
-            std::cout << "Pop out the top element containing value " << myStack.top() << std::endl;
-            myStack.pop();
+            if (!myStack.empty()) {
+                std::cout << "Pop out the top element containing value " << myStack.top() << std::endl;
+                myStack.pop();
+            }
             std::printf("\n[ INFO] Done! Return setpoint [%.1f, %.1f, %.1f]\n", setpoint.pose.position.x, setpoint.pose.position.y, setpoint.pose.position.z);
             returnHome(setpoint);
         }
         else {
             ros::spinOnce();
+            loadSnapshot();
             rate.sleep();
         }
     }
@@ -419,7 +670,7 @@ void OffboardControl::delivery(geometry_msgs::PoseStamped setpoint, double unpac
 
 bool OffboardControl::checkPositionError(double error, geometry_msgs::PoseStamped target) {
     Eigen::Vector3d geo_error;
-    geo_error << target.pose.position.x - current_odom_.pose.pose.position.x, target.pose.position.y - current_odom_.pose.pose.position.y, target.pose.position.z - current_odom_.pose.pose.position.z;
+    geo_error << target.pose.position.x - current_odom_.x, target.pose.position.y - current_odom_.y, target.pose.position.z - current_odom_.z;
 
     return (geo_error.norm() < error) ? true : false;
 }
@@ -436,54 +687,74 @@ void OffboardControl::pushIdxToStack(std::stack<int> &stack) {
 /////////// QUEUE
 
 
+ArrayQueue::ArrayQueue(WaypointStore &&store) {
+    cap = static_cast<int>(store.size());
+    front = 0;
+    rear = 0;
+    count = cap;
+    qArr = std::move(store);
+}
+
 ArrayQueue::~ArrayQueue() {
-    delete [] qArr;
+
 }
 
-void ArrayQueue::enQueue(geometry_msgs::PoseStamped x) {
-    if((rear+1)%cap == front) {
-        qArr[rear] = x; //must add this line, unless the qArr[rear] value will not be added
+void ArrayQueue::enQueue(float x, float y, float z, float yaw, float hover, uint8_t flags, uint8_t priority) {
+    if(cap == 0) {
+        return; //no slot to store it
+    }
+    if(count == cap) {
+        qArr.set((rear - 1 + cap)%cap, x, y, z, yaw, hover, flags, priority); //full, overwrite the rear element
     }
     else {
-        qArr[rear] = x;
+        qArr.set(rear, x, y, z, yaw, hover, flags, priority);
         rear = (rear+1)%cap;
+        count++;
     }
     return;
 }
 
 geometry_msgs::PoseStamped ArrayQueue::deQueue() {
-    geometry_msgs::PoseStamped retObj;
-    geometry_msgs::PoseStamped emptyObj;
-    if(rear==front) {
-        retObj = qArr[front];
-        qArr[front] = geometry_msgs::PoseStamped();  
+    int idx = deQueueIdx();
+    if(idx < 0) {
+        return geometry_msgs::PoseStamped();
     }
-    else {
-        retObj = qArr[front];
-        qArr[front] = geometry_msgs::PoseStamped();
-        std::cout << qArr[front].pose.position.x << " " << qArr[front].pose.position.y << " " << qArr[front].pose.position.z << std::endl;
-        front = (front+1)%cap;
+    return qArr.toPose(idx);
+}
+
+int ArrayQueue::deQueueIdx() {
+    if(count == 0) {
+        return -1;
+    }
+    int idx = front;
+    front = (front+1)%cap;
+    count--;
+    return idx;
+}
+
+int ArrayQueue::peekIdx(int k) {
+    if(k < 0 || k >= count) {
+        return -1;
     }
-    return retObj;
+    return (front + k)%cap;
+}
+
+int ArrayQueue::size() {
+    return count;
 }
 
 void ArrayQueue::printQueue() {
     std::cout << "Printing the queue..." << std::endl;
-    if(front==rear) {
-        std::cout << "The front element = the rear element = ";
-        ROS_INFO_STREAM(qArr[front]);
-    }
-    else{
-        for(int i = front; i <= rear; i++) {
-        ROS_INFO_STREAM(qArr[i]);
-    }
+    for(int k = 0; k < count; k++) {
+        int i = (front + k)%cap;
+        std::printf(" [%.1f, %.1f, %.1f] yaw %.2f hover %.1f (s)%s\n", qArr.x[i], qArr.y[i], qArr.z[i], qArr.yaw[i], qArr.hover[i], (qArr.flags[i] & WP_DELIVERY) ? " delivery" : "");
     }
     std::cout << "The queue is printed!" << std::endl;
 }
 
 //two functions to check whether the queue is empty or not
 bool ArrayQueue::isFull() {
-    if((rear - front + 1) == cap) {
+    if(count == cap) {
         std::cout << "The queue is full" << std::endl;
         return 1;
     }
@@ -491,13 +762,10 @@ bool ArrayQueue::isFull() {
         std::cout << "The queue is not full" << std::endl;
         return 0;
     }
-    //return 1;
 }
 
 bool ArrayQueue::isEmpty() {
-    geometry_msgs::PoseStamped null;
-    null = geometry_msgs::PoseStamped();
-    if(front==rear && poseCompare(qArr[front], null)) {
+    if(count == 0) {
         std::cout << "The queue is empty" << std::endl;
         return 1;
     }
@@ -515,4 +783,3 @@ bool ArrayQueue::poseCompare(geometry_msgs::PoseStamped x, geometry_msgs::PoseSt
         return false;
     }
 }
-
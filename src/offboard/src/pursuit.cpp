@@ -0,0 +1,75 @@
+#include "offboard/pursuit.h"
+
+#include <algorithm>
+
+static Eigen::Vector3d position(const WaypointStore &store, int slot) {
+    return Eigen::Vector3d(store.x[slot], store.y[slot], store.z[slot]);
+}
+
+void pathAhead(const Eigen::Vector3d &start, const WaypointStore &store, int idx, const std::function<int(int)> &next_slot,
+               bool allow_corners, double lookahead, std::vector<Eigen::Vector3d> &path, std::vector<char> &blend) {
+    path.assign({start, position(store, idx)});
+    blend.assign(1, 0);
+    double ahead = 0.0; // path length past the current waypoint
+    int slot = idx;
+    for (int k = 0; ; k++) {
+        int next = next_slot(k);
+        bool pass = allow_corners && next >= 0 && !(store.flags[slot] & (WP_DELIVERY | WP_VIA));
+        Eigen::Vector3d c = (next >= 0) ? position(store, next) : path.back();
+        if (pass) {
+            // turns sharper than 90 degrees would put the carrot behind the vehicle
+            pass = (path.back() - path[path.size() - 2]).dot(c - path.back()) >= 0.0;
+        }
+        blend.push_back(pass);
+        if (!pass || ahead >= lookahead) {
+            break;
+        }
+        ahead += (c - path.back()).norm();
+        path.push_back(c);
+        slot = next;
+    }
+    blend.resize(path.size());
+}
+
+double legProgress(const Eigen::Vector3d &pos, const std::vector<Eigen::Vector3d> &path) {
+    Eigen::Vector3d leg = path[1] - path[0];
+    double length = leg.norm();
+    if (length < 1e-6) {
+        return 0.0;
+    }
+    return std::min(length, std::max(0.0, (pos - path[0]).dot(leg) / length));
+}
+
+Eigen::Vector3d lookaheadAlong(const Eigen::Vector3d &pos, const std::vector<Eigen::Vector3d> &path, const std::vector<char> &blend, double lookahead) {
+    double length = (path[1] - path[0]).norm();
+    double s = legProgress(pos, path);
+    Eigen::Vector3d p = (length < 1e-6) ? path[1] : Eigen::Vector3d(path[0] + (path[1] - path[0]) * (s / length));
+    double remaining = lookahead;
+    for (std::size_t i = 1; i < path.size(); i++) {
+        double seg = (path[i] - p).norm();
+        if (remaining < seg) {
+            return p + (path[i] - p) * (remaining / seg);
+        }
+        remaining -= seg;
+        p = path[i];
+        if (!blend[i]) {
+            break;
+        }
+    }
+    return p;
+}
+
+bool waypointPassed(const Eigen::Vector3d &pos, const std::vector<Eigen::Vector3d> &path, const std::vector<char> &blend) {
+    Eigen::Vector3d in = path[1] - path[0];
+    if (in.norm() < 1e-6) {
+        return true; // already at the waypoint when the leg started
+    }
+    Eigen::Vector3d normal = in.normalized();
+    if (blend[1] && path.size() > 2 && (path[2] - path[1]).norm() > 1e-6) {
+        Eigen::Vector3d bisector = normal + (path[2] - path[1]).normalized(); // blended turns are at most 90 degrees
+        if (bisector.norm() > 1e-6) {
+            normal = bisector;
+        }
+    }
+    return (pos - path[1]).dot(normal) >= 0.0;
+}
@@ -0,0 +1,91 @@
+/* stress test and contention benchmark of SeqLock
+   usage: rosrun offboard seqlock_stress [stores] [reader threads]
+   exit code 1 if any reader saw a torn snapshot */
+#include "offboard/seqlock.h"
+#include "offboard/vehicle_snapshot.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+static double nsPerOp(Clock::time_point t_start, long ops) {
+    return std::chrono::duration<double, std::nano>(Clock::now() - t_start).count() / ops;
+}
+
+/* every field of the snapshot carries the same counter, a torn copy mixes two of them */
+static OdomSnapshot stamped(long k) {
+    OdomSnapshot odom;
+    odom.stamp = odom.x = odom.y = odom.z = k;
+    odom.qx = odom.qy = odom.qz = odom.qw = k;
+    odom.vx = odom.vy = odom.vz = k;
+    return odom;
+}
+
+static bool consistent(const OdomSnapshot &odom) {
+    return odom.x == odom.stamp && odom.y == odom.stamp && odom.z == odom.stamp
+        && odom.qx == odom.stamp && odom.qy == odom.stamp && odom.qz == odom.stamp && odom.qw == odom.stamp
+        && odom.vx == odom.stamp && odom.vy == odom.stamp && odom.vz == odom.stamp;
+}
+
+int main(int argc, char **argv)
+{
+    long stores = (argc > 1) ? std::strtol(argv[1], nullptr, 10) : 5000000;
+    int readers = (argc > 2) ? std::atoi(argv[2]) : 2;
+    SeqLock<OdomSnapshot> lock;
+
+    // uncontended
+    Clock::time_point t_start = Clock::now();
+    for (long k = 0; k < stores; k++) {
+        lock.store(stamped(k));
+    }
+    std::printf("[ INFO] uncontended store: %.1f (ns)\n", nsPerOp(t_start, stores));
+    double sink = 0.0;
+    t_start = Clock::now();
+    for (long k = 0; k < stores; k++) {
+        sink += lock.load().x;
+    }
+    std::printf("[ INFO] uncontended load: %.1f (ns)\n", nsPerOp(t_start, stores));
+
+    // one writer (the odometry callback) against reader threads (control loops), checking every snapshot
+    std::atomic<bool> stop(false);
+    std::vector<long> reads(readers, 0), torn(readers, 0);
+    std::vector<std::thread> pool;
+    for (int r = 0; r < readers; r++) {
+        pool.emplace_back([&, r] {
+            double last = -1.0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                OdomSnapshot odom = lock.load();
+                if (!consistent(odom) || odom.stamp < last) {
+                    torn[r]++;
+                }
+                last = odom.stamp;
+                reads[r]++;
+            }
+        });
+    }
+    t_start = Clock::now();
+    for (long k = stores; k < 2 * stores; k++) {
+        lock.store(stamped(k));
+    }
+    double store_ns = nsPerOp(t_start, stores);
+    stop = true;
+    for (std::thread &t : pool) {
+        t.join();
+    }
+    double load_ns = std::chrono::duration<double, std::nano>(Clock::now() - t_start).count();
+
+    long total_reads = 0, total_torn = 0;
+    for (int r = 0; r < readers; r++) {
+        total_reads += reads[r];
+        total_torn += torn[r];
+    }
+    std::printf("[ INFO] contended store (%d reader(s)): %.1f (ns)\n", readers, store_ns);
+    std::printf("[ INFO] contended load: %.1f (ns), %ld read(s)\n", total_reads ? load_ns * readers / total_reads : 0.0, total_reads);
+    std::printf("[ %s] %ld torn snapshot(s) in %ld store(s)\n", total_torn ? "ERROR" : "INFO", total_torn, stores);
+    return (total_torn != 0 || sink < 0.0) ? 1 : 0;
+}
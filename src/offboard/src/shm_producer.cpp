@@ -0,0 +1,66 @@
+/* stand-in planner: writes a lawnmower plan into the shared-memory waypoint channel
+   usage: rosrun offboard shm_producer [name] [number of points] [plan id] [spacing (m)] */
+#include "offboard/shm_waypoint.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+int main(int argc, char **argv)
+{
+    const char *name = (argc > 1) ? argv[1] : "/offboard_waypoints";
+    uint32_t num_points = (argc > 2) ? std::strtoul(argv[2], nullptr, 10) : 100000;
+    uint32_t plan_id = (argc > 3) ? std::strtoul(argv[3], nullptr, 10) : 1;
+    float spacing = (argc > 4) ? std::strtof(argv[4], nullptr) : 1.0f;
+    const uint32_t row = 100; // points per lawnmower row
+    const float altitude = 5.0f;
+
+    if (num_points == 0) {
+        std::printf("[ ERROR] Number of points must be positive\n");
+        return 1;
+    }
+
+    std::vector<shm_wp_record> plan(num_points);
+    for (uint32_t i = 0; i < num_points; i++) {
+        uint32_t r = i / row;
+        uint32_t c = (r % 2 == 0) ? i % row : row - 1 - i % row;
+        shm_wp_record &wp = plan[i];
+        wp.x = c * spacing;
+        wp.y = r * spacing;
+        wp.z = altitude;
+        wp.yaw = 0.0f;
+        wp.hover = 0.0f;
+        wp.flags = 0;
+        wp.priority = 0;
+        wp.reserved = 0;
+        wp.plan_id = plan_id;
+        wp.index = i;
+    }
+    plan.back().flags = SHM_WP_DELIVERY; // deliver at the end of the plan
+    plan.back().hover = 5.0f;
+
+    shm_wp_channel *ch = shm_wp_create(name, SHM_WP_DEFAULT_CAPACITY);
+    if (ch == nullptr) {
+        std::printf("[ ERROR] Cannot create shared memory '%s'\n", name);
+        return 1;
+    }
+    std::printf("[ INFO] Writing plan %u (%u points) to '%s'\n", plan_id, num_points, name);
+
+    auto t_start = std::chrono::steady_clock::now();
+    shm_wp_begin_plan(ch, plan_id, num_points);
+    size_t written = 0;
+    while (written < num_points) {
+        size_t n = shm_wp_write(ch, plan.data() + written, num_points - written);
+        written += n;
+        if (n == 0) {
+            std::this_thread::yield(); // ring full, wait for the consumer
+        }
+    }
+    auto t_end = std::chrono::steady_clock::now();
+    std::printf("[ INFO] Plan written in %.1f (us)\n", std::chrono::duration<double, std::micro>(t_end - t_start).count());
+
+    shm_wp_close(ch);
+    return 0;
+}
@@ -0,0 +1,197 @@
+#include "offboard/shm_waypoint.h"
+
+#include <atomic>
+#include <cstring>
+#include <new>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static_assert(sizeof(shm_wp_record) == 32, "shm_wp_record layout is part of SHM_WP_VERSION");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "ring indices must be lock-free to live in shared memory");
+
+namespace {
+
+const uint64_t NO_PLAN = ~0ull;
+
+/* start of the segment, records follow at sizeof(ShmHeader)
+   head/tail are monotonic record counters, each on its own cache line */
+struct ShmHeader {
+    std::atomic<uint32_t> magic; // written last by the producer, segment usable once it reads SHM_WP_MAGIC
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t capacity; // power of two
+    alignas(64) std::atomic<uint64_t> head; // records written by the producer
+    alignas(64) std::atomic<uint64_t> tail; // records read by the consumer
+    alignas(64) std::atomic<uint64_t> plan; // (plan_id << 32) | num_points, NO_PLAN before the first plan
+    std::atomic<uint64_t> plan_start; // head when the plan was announced, its first record
+};
+
+size_t segmentSize(uint32_t capacity) {
+    return sizeof(ShmHeader) + static_cast<size_t>(capacity) * sizeof(shm_wp_record);
+}
+
+uint32_t roundUpPow2(uint32_t n) {
+    uint32_t p = 1;
+    while (p < n && p < (1u << 31)) {
+        p <<= 1;
+    }
+    return p;
+}
+
+}
+
+struct shm_wp_channel {
+    ShmHeader *hdr;
+    shm_wp_record *ring;
+    size_t size;
+    uint32_t capacity; // validated copy of hdr->capacity, the header stays writable by the peer
+    int fd; // kept open to notice when the segment gets unlinked
+};
+
+static shm_wp_channel *mapChannel(int fd, size_t size) {
+    void *base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0); // prefault the ring
+    if (base == MAP_FAILED) {
+        close(fd);
+        return nullptr;
+    }
+    shm_wp_channel *ch = new (std::nothrow) shm_wp_channel;
+    if (ch == nullptr) {
+        munmap(base, size);
+        close(fd);
+        return nullptr;
+    }
+    ch->hdr = static_cast<ShmHeader *>(base);
+    ch->ring = reinterpret_cast<shm_wp_record *>(static_cast<char *>(base) + sizeof(ShmHeader));
+    ch->size = size;
+    ch->capacity = 0;
+    ch->fd = fd;
+    return ch;
+}
+
+shm_wp_channel *shm_wp_create(const char *name, uint32_t capacity) {
+    capacity = roundUpPow2(capacity == 0 ? SHM_WP_DEFAULT_CAPACITY : capacity);
+    size_t size = segmentSize(capacity);
+    shm_unlink(name); // a consumer mapping the old segment keeps it, see shm_wp_stale()
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0660); // owner and group only, anyone who can write it can inject waypoints
+    if (fd < 0) {
+        return nullptr;
+    }
+    if (ftruncate(fd, size) != 0) {
+        close(fd);
+        return nullptr;
+    }
+    shm_wp_channel *ch = mapChannel(fd, size);
+    if (ch == nullptr) {
+        return nullptr;
+    }
+    ShmHeader *hdr = ch->hdr;
+    hdr->magic.store(0, std::memory_order_relaxed);
+    hdr->version = SHM_WP_VERSION;
+    hdr->record_size = sizeof(shm_wp_record);
+    hdr->capacity = capacity;
+    ch->capacity = capacity;
+    hdr->head.store(0, std::memory_order_relaxed);
+    hdr->tail.store(0, std::memory_order_relaxed);
+    hdr->plan.store(NO_PLAN, std::memory_order_relaxed);
+    hdr->plan_start.store(0, std::memory_order_relaxed);
+    hdr->magic.store(SHM_WP_MAGIC, std::memory_order_release);
+    return ch;
+}
+
+shm_wp_channel *shm_wp_open(const char *name) {
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(ShmHeader)) {
+        close(fd);
+        return nullptr;
+    }
+    shm_wp_channel *ch = mapChannel(fd, st.st_size);
+    if (ch == nullptr) {
+        return nullptr;
+    }
+    ShmHeader *hdr = ch->hdr;
+    uint32_t capacity = hdr->capacity;
+    if (hdr->magic.load(std::memory_order_acquire) != SHM_WP_MAGIC || hdr->version != SHM_WP_VERSION
+        || hdr->record_size != sizeof(shm_wp_record) || capacity == 0 || (capacity & (capacity - 1)) != 0
+        || segmentSize(capacity) > ch->size) {
+        shm_wp_close(ch);
+        return nullptr;
+    }
+    ch->capacity = capacity;
+    return ch;
+}
+
+void shm_wp_close(shm_wp_channel *ch) {
+    if (ch == nullptr) {
+        return;
+    }
+    munmap(ch->hdr, ch->size);
+    close(ch->fd);
+    delete ch;
+}
+
+int shm_wp_unlink(const char *name) {
+    return shm_unlink(name);
+}
+
+int shm_wp_stale(shm_wp_channel *ch) {
+    struct stat st;
+    return (fstat(ch->fd, &st) != 0 || st.st_nlink == 0) ? 1 : 0;
+}
+
+void shm_wp_begin_plan(shm_wp_channel *ch, uint32_t plan_id, uint32_t num_points) {
+    ch->hdr->plan_start.store(ch->hdr->head.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    ch->hdr->plan.store((static_cast<uint64_t>(plan_id) << 32) | num_points, std::memory_order_release);
+}
+
+size_t shm_wp_write(shm_wp_channel *ch, const shm_wp_record *records, size_t n) {
+    ShmHeader *hdr = ch->hdr;
+    uint64_t head = hdr->head.load(std::memory_order_relaxed);
+    uint64_t tail = hdr->tail.load(std::memory_order_acquire);
+    size_t used = static_cast<size_t>(head - tail);
+    size_t free_slots = (used < ch->capacity) ? ch->capacity - used : 0;
+    if (n > free_slots) {
+        n = free_slots;
+    }
+    size_t start = head & (ch->capacity - 1);
+    size_t first = (n < ch->capacity - start) ? n : ch->capacity - start; // up to the end of the ring, rest wraps
+    std::memcpy(ch->ring + start, records, first * sizeof(shm_wp_record));
+    std::memcpy(ch->ring, records + first, (n - first) * sizeof(shm_wp_record));
+    hdr->head.store(head + n, std::memory_order_release);
+    return n;
+}
+
+int shm_wp_plan_info(shm_wp_channel *ch, uint32_t *plan_id, uint32_t *num_points) {
+    uint64_t plan = ch->hdr->plan.load(std::memory_order_acquire);
+    if (plan == NO_PLAN) {
+        return SHM_WP_NO_PLAN;
+    }
+    *plan_id = static_cast<uint32_t>(plan >> 32);
+    *num_points = static_cast<uint32_t>(plan);
+    uint64_t start = ch->hdr->plan_start.load(std::memory_order_relaxed);
+    return (ch->hdr->tail.load(std::memory_order_acquire) > start) ? SHM_WP_PLAN_CONSUMED : SHM_WP_PLAN_PENDING;
+}
+
+size_t shm_wp_read(shm_wp_channel *ch, shm_wp_record *out, size_t max) {
+    ShmHeader *hdr = ch->hdr;
+    uint64_t tail = hdr->tail.load(std::memory_order_relaxed);
+    uint64_t head = hdr->head.load(std::memory_order_acquire);
+    size_t n = static_cast<size_t>(head - tail);
+    if (n > ch->capacity) {
+        n = ch->capacity; // never copy more than the ring holds, even from a corrupt head
+    }
+    if (n > max) {
+        n = max;
+    }
+    size_t start = tail & (ch->capacity - 1);
+    size_t first = (n < ch->capacity - start) ? n : ch->capacity - start;
+    std::memcpy(out, ch->ring + start, first * sizeof(shm_wp_record));
+    std::memcpy(out + first, ch->ring, (n - first) * sizeof(shm_wp_record));
+    hdr->tail.store(tail + n, std::memory_order_release);
+    return n;
+}
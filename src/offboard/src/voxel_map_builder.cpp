@@ -0,0 +1,96 @@
+/* writes a voxel map for the planner (voxel_map param of offboard_node)
+   usage: rosrun offboard voxel_map_builder [output file] [box file]
+   box file: first line "resolution min_x min_y min_z max_x max_y max_z" (map extent, meter),
+             then one obstacle per line "min_x min_y min_z max_x max_y max_z", '#' starts a comment
+   without a box file a 10 x 10 city-block demo is written (300 x 300 x 40 m, 1 m voxels) */
+#include "offboard/voxel_planner.h"
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+
+static bool readBoxes(const std::string &path, VoxelMap &map, int &num_boxes)
+{
+    std::ifstream in(path);
+    std::string line;
+    bool have_extent = false;
+    num_boxes = 0;
+    while (std::getline(in, line)) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        float v[7];
+        if (!have_extent) {
+            if (!(fields >> v[0])) {
+                continue; // blank or comment line
+            }
+            if (!(fields >> v[1] >> v[2] >> v[3] >> v[4] >> v[5] >> v[6]) || !(v[0] > 0.0f) || v[4] <= v[1] || v[5] <= v[2] || v[6] <= v[3]) {
+                std::printf("[ ERROR] Bad map extent in '%s'\n", path.c_str());
+                return false;
+            }
+            map.resize(std::ceil((v[4] - v[1]) / v[0]), std::ceil((v[5] - v[2]) / v[0]), std::ceil((v[6] - v[3]) / v[0]), v[0], v[1], v[2], v[3]);
+            have_extent = true;
+            continue;
+        }
+        if (!(fields >> v[0])) {
+            continue;
+        }
+        if (!(fields >> v[1] >> v[2] >> v[3] >> v[4] >> v[5])) {
+            std::printf("[ ERROR] Bad box in '%s': %s\n", path.c_str(), line.c_str());
+            return false;
+        }
+        map.fillBox(v[0], v[1], v[2], v[3], v[4], v[5]);
+        num_boxes++;
+    }
+    if (!have_extent) {
+        std::printf("[ ERROR] Cannot read map extent from '%s'\n", path.c_str());
+    }
+    return have_extent;
+}
+
+/* buildings of random height on a 30 m grid, 10 m wide streets starting at the origin */
+static void cityBlocks(VoxelMap &map, int &num_boxes)
+{
+    std::mt19937 rng(1);
+    map.resize(300, 300, 40, 1.0f, 0.0f, 0.0f, 0.0f);
+    num_boxes = 0;
+    for (int bx = 0; bx < 10; bx++) {
+        for (int by = 0; by < 10; by++) {
+            float height = 10.0f + rng() % 25;
+            map.fillBox(bx * 30.0f + 5.0f, by * 30.0f + 5.0f, 0.0f, bx * 30.0f + 24.5f, by * 30.0f + 24.5f, height - 0.5f);
+            num_boxes++;
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::string output = (argc > 1) ? argv[1] : "city.voxm";
+    VoxelMap map;
+    int num_boxes = 0;
+    if (argc > 2) {
+        if (!readBoxes(argv[2], map, num_boxes)) {
+            return 1;
+        }
+    }
+    else {
+        cityBlocks(map, num_boxes);
+    }
+
+    std::size_t occupied = 0;
+    for (int z = 0; z < map.nz; z++) {
+        for (int y = 0; y < map.ny; y++) {
+            for (int x = 0; x < map.nx; x++) {
+                occupied += map.occupied(x, y, z);
+            }
+        }
+    }
+    if (!map.save(output)) {
+        std::printf("[ ERROR] Cannot write '%s'\n", output.c_str());
+        return 1;
+    }
+    std::printf("[ INFO] %dx%dx%d voxel map (%.2f m), %d box(es), %zu occupied voxel(s) written to '%s'\n", map.nx, map.ny, map.nz, map.resolution, num_boxes, occupied, output.c_str());
+    return 0;
+}
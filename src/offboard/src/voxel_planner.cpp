@@ -0,0 +1,540 @@
+#include "offboard/voxel_planner.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <queue>
+#include <thread>
+
+/////////// VOXEL MAP
+
+
+static const char VOXEL_MAP_MAGIC[4] = {'V', 'O', 'X', 'M'};
+static const uint32_t VOXEL_MAP_VERSION = 1;
+
+void VoxelMap::resize(int sx, int sy, int sz, float res, float x0, float y0, float z0) {
+    nx = sx;
+    ny = sy;
+    nz = sz;
+    resolution = res;
+    ox = x0;
+    oy = y0;
+    oz = z0;
+    bits.assign((static_cast<std::size_t>(nx) * ny * nz + 63) / 64, 0);
+}
+
+bool VoxelMap::load(const std::string &path) {
+    std::ifstream in(path, std::ios::binary);
+    char magic[4];
+    uint32_t version, dims[3];
+    float meta[4];
+    if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, VOXEL_MAP_MAGIC, sizeof(magic)) != 0) {
+        return false;
+    }
+    if (!in.read(reinterpret_cast<char *>(&version), sizeof(version)) || version != VOXEL_MAP_VERSION) {
+        return false;
+    }
+    if (!in.read(reinterpret_cast<char *>(dims), sizeof(dims)) || !in.read(reinterpret_cast<char *>(meta), sizeof(meta))) {
+        return false;
+    }
+    if (dims[0] == 0 || dims[1] == 0 || dims[2] == 0 || !(meta[0] > 0.0f)) {
+        return false;
+    }
+    resize(dims[0], dims[1], dims[2], meta[0], meta[1], meta[2], meta[3]);
+    return static_cast<bool>(in.read(reinterpret_cast<char *>(bits.data()), bits.size() * sizeof(uint64_t)));
+}
+
+bool VoxelMap::save(const std::string &path) const {
+    std::ofstream out(path, std::ios::binary);
+    uint32_t dims[3] = {static_cast<uint32_t>(nx), static_cast<uint32_t>(ny), static_cast<uint32_t>(nz)};
+    float meta[4] = {resolution, ox, oy, oz};
+    out.write(VOXEL_MAP_MAGIC, sizeof(VOXEL_MAP_MAGIC));
+    out.write(reinterpret_cast<const char *>(&VOXEL_MAP_VERSION), sizeof(VOXEL_MAP_VERSION));
+    out.write(reinterpret_cast<const char *>(dims), sizeof(dims));
+    out.write(reinterpret_cast<const char *>(meta), sizeof(meta));
+    out.write(reinterpret_cast<const char *>(bits.data()), bits.size() * sizeof(uint64_t));
+    return static_cast<bool>(out);
+}
+
+void VoxelMap::setOccupied(int x, int y, int z, bool value) {
+    if (!inside(x, y, z)) {
+        return;
+    }
+    std::size_t i = index(x, y, z);
+    if (value) {
+        bits[i >> 6] |= (1ull << (i & 63));
+    }
+    else {
+        bits[i >> 6] &= ~(1ull << (i & 63));
+    }
+}
+
+void VoxelMap::fillBox(float x0, float y0, float z0, float x1, float y1, float z1) {
+    int ax, ay, az, bx, by, bz;
+    toVoxel(std::min(x0, x1), std::min(y0, y1), std::min(z0, z1), ax, ay, az);
+    toVoxel(std::max(x0, x1), std::max(y0, y1), std::max(z0, z1), bx, by, bz);
+    for (int z = std::max(0, az); z <= std::min(nz - 1, bz); z++) {
+        for (int y = std::max(0, ay); y <= std::min(ny - 1, by); y++) {
+            for (int x = std::max(0, ax); x <= std::min(nx - 1, bx); x++) {
+                setOccupied(x, y, z, true);
+            }
+        }
+    }
+}
+
+/* dilate by radius, conservatively: a voxel gets blocked if any point of it lies closer than radius to the
+   obstacle voxel (box-to-box distance), so even a radius below one voxel blocks the 26 neighbours
+   only occupied voxels next to free space need to be spread */
+void VoxelMap::inflate(float radius) {
+    float r = radius / resolution;
+    if (!(r > 0.0f)) {
+        return;
+    }
+    int reach = static_cast<int>(std::ceil(r));
+    std::vector<int> ball; // dx, dy, dz triples
+    for (int dz = -reach; dz <= reach; dz++) {
+        for (int dy = -reach; dy <= reach; dy++) {
+            for (int dx = -reach; dx <= reach; dx++) {
+                // gap between the two voxels along each axis, in voxels
+                int gx = std::max(std::abs(dx) - 1, 0), gy = std::max(std::abs(dy) - 1, 0), gz = std::max(std::abs(dz) - 1, 0);
+                if (gx * gx + gy * gy + gz * gz < r * r) {
+                    ball.insert(ball.end(), {dx, dy, dz});
+                }
+            }
+        }
+    }
+    const VoxelMap original = *this;
+    for (int z = 0; z < nz; z++) {
+        for (int y = 0; y < ny; y++) {
+            for (int x = 0; x < nx; x++) {
+                if (!original.occupied(x, y, z)) {
+                    continue;
+                }
+                bool boundary = false;
+                const int face[6][3] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+                for (int k = 0; k < 6 && !boundary; k++) {
+                    int fx = x + face[k][0], fy = y + face[k][1], fz = z + face[k][2];
+                    boundary = original.inside(fx, fy, fz) && !original.occupied(fx, fy, fz);
+                }
+                if (!boundary) {
+                    continue;
+                }
+                for (std::size_t k = 0; k < ball.size(); k += 3) {
+                    setOccupied(x + ball[k], y + ball[k + 1], z + ball[k + 2], true);
+                }
+            }
+        }
+    }
+}
+
+bool VoxelMap::toVoxel(float x, float y, float z, int &vx, int &vy, int &vz) const {
+    vx = static_cast<int>(std::floor((x - ox) / resolution));
+    vy = static_cast<int>(std::floor((y - oy) / resolution));
+    vz = static_cast<int>(std::floor((z - oz) / resolution));
+    return inside(vx, vy, vz);
+}
+
+void VoxelMap::toWorld(int vx, int vy, int vz, float &x, float &y, float &z) const {
+    x = ox + (vx + 0.5f) * resolution;
+    y = oy + (vy + 0.5f) * resolution;
+    z = oz + (vz + 0.5f) * resolution;
+}
+
+/* exact voxel traversal (Amanatides-Woo) of the segment, every voxel it touches must be free
+   where it crosses a voxel edge or corner, the voxels beside the crossing are checked as well (same rule as A*) */
+bool VoxelMap::lineFree(float x0, float y0, float z0, float x1, float y1, float z1) const {
+    int v[3], end[3];
+    if (!toVoxel(x0, y0, z0, v[0], v[1], v[2]) || !toVoxel(x1, y1, z1, end[0], end[1], end[2])) {
+        return false;
+    }
+    const float p[3] = {x0 - ox, y0 - oy, z0 - oz};
+    const float d[3] = {x1 - x0, y1 - y0, z1 - z0};
+    int step[3];
+    float t_max[3], t_delta[3]; // along the segment, 0 at the start and 1 at the end
+    for (int a = 0; a < 3; a++) {
+        if (d[a] > 0.0f) {
+            step[a] = 1;
+            t_max[a] = ((v[a] + 1) * resolution - p[a]) / d[a];
+            t_delta[a] = resolution / d[a];
+        }
+        else if (d[a] < 0.0f) {
+            step[a] = -1;
+            t_max[a] = (v[a] * resolution - p[a]) / d[a];
+            t_delta[a] = -resolution / d[a];
+        }
+        else {
+            step[a] = 0;
+            t_max[a] = t_delta[a] = INFINITY;
+        }
+    }
+    const float tie = 1e-4f * resolution / std::max(std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]), 1e-6f);
+    int budget = std::abs(end[0] - v[0]) + std::abs(end[1] - v[1]) + std::abs(end[2] - v[2]) + 3;
+    while (true) {
+        if (occupied(v[0], v[1], v[2])) {
+            return false;
+        }
+        if ((v[0] == end[0] && v[1] == end[1] && v[2] == end[2]) || budget-- <= 0) {
+            break;
+        }
+        float t = std::min(t_max[0], std::min(t_max[1], t_max[2]));
+        if (t > 1.0f) {
+            break;
+        }
+        int axes = 0; // axes crossed at t
+        for (int a = 0; a < 3; a++) {
+            if (t_max[a] - t <= tie) {
+                axes |= 1 << a;
+            }
+        }
+        // crossing an edge or corner: the voxels reached by a part of the step must be free too
+        for (int mask = 1; mask < axes; mask++) {
+            if ((mask & axes) == mask && mask != axes
+                && occupied(v[0] + ((mask & 1) ? step[0] : 0), v[1] + ((mask & 2) ? step[1] : 0), v[2] + ((mask & 4) ? step[2] : 0))) {
+                return false;
+            }
+        }
+        for (int a = 0; a < 3; a++) {
+            if (axes & (1 << a)) {
+                v[a] += step[a];
+                t_max[a] += t_delta[a];
+            }
+        }
+    }
+    return !occupied(end[0], end[1], end[2]);
+}
+
+/////////// VOXEL PLANNER
+
+
+namespace {
+
+/* one of the 26 grid moves and the axis-aligned voxels it must not cut through */
+struct Move {
+    int dx, dy, dz;
+    float cost;
+    int num_side;
+    int side[6][3];
+};
+
+const std::vector<Move> &gridMoves() {
+    static const std::vector<Move> moves = [] {
+        std::vector<Move> list;
+        for (int dz = -1; dz <= 1; dz++) {
+            for (int dy = -1; dy <= 1; dy++) {
+                for (int dx = -1; dx <= 1; dx++) {
+                    int axes = (dx != 0) + (dy != 0) + (dz != 0);
+                    if (axes == 0) {
+                        continue;
+                    }
+                    Move m = {dx, dy, dz, std::sqrt(static_cast<float>(axes)), 0, {}};
+                    // every proper, non-empty subset of the move components
+                    for (int mask = 1; mask < 7; mask++) {
+                        int sx = (mask & 1) ? dx : 0, sy = (mask & 2) ? dy : 0, sz = (mask & 4) ? dz : 0;
+                        int sub = (sx != 0) + (sy != 0) + (sz != 0);
+                        if (sub == 0 || sub == axes || ((mask & 1) && dx == 0) || ((mask & 2) && dy == 0) || ((mask & 4) && dz == 0)) {
+                            continue;
+                        }
+                        m.side[m.num_side][0] = sx;
+                        m.side[m.num_side][1] = sy;
+                        m.side[m.num_side][2] = sz;
+                        m.num_side++;
+                    }
+                    list.push_back(m);
+                }
+            }
+        }
+        return list;
+    }();
+    return moves;
+}
+
+/* exact free-space distance on the 26-connected grid, consistent for A* */
+inline float octile3(int dx, int dy, int dz) {
+    int d[3] = {std::abs(dx), std::abs(dy), std::abs(dz)};
+    std::sort(d, d + 3);
+    return 1.7320508f * d[0] + 1.4142136f * (d[1] - d[0]) + (d[2] - d[1]);
+}
+
+/* per-thread search buffers over the leg bounding box, reset by bumping the generation */
+struct SearchBuffers {
+    std::vector<float> g;
+    std::vector<int> parent;
+    std::vector<uint32_t> seen, closed;
+    uint32_t generation = 0;
+
+    void release() { // give the memory back, the next prepare() starts over
+        std::vector<float>().swap(g);
+        std::vector<int>().swap(parent);
+        std::vector<uint32_t>().swap(seen);
+        std::vector<uint32_t>().swap(closed);
+        generation = 0;
+    }
+
+    void prepare(std::size_t n) {
+        if (seen.size() < n) {
+            g.resize(n);
+            parent.resize(n);
+            seen.resize(n, 0);
+            closed.resize(n, 0);
+        }
+        if (++generation == 0) {
+            std::fill(seen.begin(), seen.end(), 0);
+            std::fill(closed.begin(), closed.end(), 0);
+            generation = 1;
+        }
+    }
+};
+
+SearchBuffers &threadBuffers() {
+    thread_local SearchBuffers buf;
+    return buf;
+}
+
+/* a retry may grow its box until the search buffers reach about 64 MiB (16 bytes per voxel), it runs on one thread at a time */
+const std::size_t RETRY_MAX_VOXELS = std::size_t(1) << 22;
+
+}
+
+VoxelPlanner::VoxelPlanner(const VoxelMap &map, double budget_ms, int margin) : map_(map),
+                                                                               budget_ms_(budget_ms),
+                                                                               margin_(margin)
+                                                                               {
+
+}
+
+std::size_t VoxelPlanner::boxVoxels(int sx, int sy, int sz, int gx, int gy, int gz, int margin) const {
+    std::size_t bx = std::min(map_.nx - 1, std::max(sx, gx) + margin) - std::max(0, std::min(sx, gx) - margin) + 1;
+    std::size_t by = std::min(map_.ny - 1, std::max(sy, gy) + margin) - std::max(0, std::min(sy, gy) - margin) + 1;
+    std::size_t bz = std::min(map_.nz - 1, std::max(sz, gz) + margin) - std::max(0, std::min(sz, gz) - margin) + 1;
+    return bx * by * bz;
+}
+
+/* A* from voxel s to voxel g inside their bounding box plus margin voxels, path holds map indices of the voxels from s to g */
+bool VoxelPlanner::search(int sx, int sy, int sz, int gx, int gy, int gz, int margin, double budget_ms, std::vector<int> &path, double &elapsed_ms) {
+    typedef std::chrono::steady_clock clock;
+    SearchBuffers &buf = threadBuffers();
+
+    int x0 = std::max(0, std::min(sx, gx) - margin), x1 = std::min(map_.nx - 1, std::max(sx, gx) + margin);
+    int y0 = std::max(0, std::min(sy, gy) - margin), y1 = std::min(map_.ny - 1, std::max(sy, gy) + margin);
+    int z0 = std::max(0, std::min(sz, gz) - margin), z1 = std::min(map_.nz - 1, std::max(sz, gz) + margin);
+    int bx = x1 - x0 + 1, by = y1 - y0 + 1, bz = z1 - z0 + 1;
+    buf.prepare(static_cast<std::size_t>(bx) * by * bz);
+    const uint32_t gen = buf.generation;
+    clock::time_point t_start = clock::now(); // buffers grow once per thread, not charged to the budget
+    auto local = [&](int x, int y, int z) {
+        return (x - x0) + bx * ((y - y0) + by * (z - z0));
+    };
+
+    typedef std::pair<float, int> Entry; // f, local index
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> open;
+    int start = local(sx, sy, sz), goal = local(gx, gy, gz);
+    buf.g[start] = 0.0f;
+    buf.parent[start] = -1;
+    buf.seen[start] = gen;
+    open.push(Entry(octile3(gx - sx, gy - sy, gz - sz), start));
+
+    const std::vector<Move> &moves = gridMoves();
+    const float weight = 2.0f; // weighted A*, path cost within 2x of optimal, line of sight straightens it afterwards
+    std::size_t expanded = 0;
+    bool found = false;
+    while (!open.empty()) {
+        int cur = open.top().second;
+        open.pop();
+        if (buf.closed[cur] == gen) {
+            continue;
+        }
+        buf.closed[cur] = gen;
+        if (cur == goal) {
+            found = true;
+            break;
+        }
+        if ((++expanded & 255) == 0 && std::chrono::duration<double, std::milli>(clock::now() - t_start).count() > budget_ms) {
+            break;
+        }
+        int cx = cur % bx + x0, cy = (cur / bx) % by + y0, cz = cur / (bx * by) + z0;
+        for (const Move &m : moves) {
+            int nx = cx + m.dx, ny = cy + m.dy, nz = cz + m.dz;
+            if (nx < x0 || nx > x1 || ny < y0 || ny > y1 || nz < z0 || nz > z1 || map_.occupied(nx, ny, nz)) {
+                continue;
+            }
+            bool blocked = false;
+            for (int k = 0; k < m.num_side && !blocked; k++) {
+                blocked = map_.occupied(cx + m.side[k][0], cy + m.side[k][1], cz + m.side[k][2]);
+            }
+            if (blocked) {
+                continue;
+            }
+            int next = local(nx, ny, nz);
+            if (buf.closed[next] == gen) {
+                continue;
+            }
+            float g = buf.g[cur] + m.cost;
+            if (buf.seen[next] != gen || g < buf.g[next]) {
+                buf.seen[next] = gen;
+                buf.g[next] = g;
+                buf.parent[next] = cur;
+                open.push(Entry(g + weight * octile3(gx - nx, gy - ny, gz - nz), next));
+            }
+        }
+    }
+    elapsed_ms = std::chrono::duration<double, std::milli>(clock::now() - t_start).count();
+    if (!found) {
+        return false;
+    }
+
+    path.clear();
+    for (int cur = goal; cur >= 0; cur = buf.parent[cur]) {
+        path.push_back(static_cast<int>(map_.index(cur % bx + x0, (cur / bx) % by + y0, cur / (bx * by) + z0)));
+    }
+    std::reverse(path.begin(), path.end());
+    return true;
+}
+
+bool VoxelPlanner::planLeg(float fx, float fy, float fz, float tx, float ty, float tz, std::vector<float> &via, PlannerStats &stats, bool retry) {
+    via.clear();
+    stats.legs++;
+    if (map_.lineFree(fx, fy, fz, tx, ty, tz)) {
+        return true;
+    }
+    int sx, sy, sz, gx, gy, gz;
+    if (!map_.toVoxel(fx, fy, fz, sx, sy, sz) || !map_.toVoxel(tx, ty, tz, gx, gy, gz)
+        || map_.occupied(sx, sy, sz) || map_.occupied(gx, gy, gz)) {
+        stats.failed++;
+        return false;
+    }
+
+    uint64_t key = static_cast<uint64_t>(map_.index(sx, sy, sz)) * (static_cast<uint64_t>(map_.nx) * map_.ny * map_.nz) + map_.index(gx, gy, gz);
+    Leg leg;
+    bool hit = false;
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex_);
+        auto it = cache_.find(key);
+        if (it != cache_.end() && (it->second.ok || !retry)) {
+            leg = it->second;
+            hit = true;
+        }
+    }
+    if (hit) {
+        stats.cached++;
+    }
+    else if (!retry && boxVoxels(sx, sy, sz, gx, gy, gz, margin_) > RETRY_MAX_VOXELS) {
+        stats.failed++;
+        return false; // too large for every worker to hold its buffers, left to the retry
+    }
+    else {
+        std::vector<int> path;
+        double elapsed_ms = 0.0;
+        int margin = margin_;
+        if (retry) {
+            // detour leaves the box or needs more time: grow the box as far as the buffer cap allows
+            int widest = std::max(map_.nx, std::max(map_.ny, map_.nz));
+            while (margin < widest && boxVoxels(sx, sy, sz, gx, gy, gz, std::min(widest, margin + margin_)) <= RETRY_MAX_VOXELS) {
+                margin = std::min(widest, margin + margin_);
+            }
+        }
+        leg.ok = search(sx, sy, sz, gx, gy, gz, margin, retry ? 4.0 * budget_ms_ : budget_ms_, path, elapsed_ms);
+        stats.max_ms = std::max(stats.max_ms, elapsed_ms);
+        // voxel centers between the end voxels, the exact endpoints are added back below
+        for (std::size_t k = 1; leg.ok && k + 1 < path.size(); k++) {
+            std::size_t i = path[k];
+            float x, y, z;
+            map_.toWorld(i % map_.nx, (i / map_.nx) % map_.ny, i / (static_cast<std::size_t>(map_.nx) * map_.ny), x, y, z);
+            leg.via.push_back(x);
+            leg.via.push_back(y);
+            leg.via.push_back(z);
+        }
+        std::lock_guard<std::mutex> lock(cache_mutex_);
+        cache_[key] = leg;
+    }
+    if (!leg.ok) {
+        stats.failed++;
+        return false;
+    }
+
+    // keep only the points where the line of sight breaks
+    std::vector<float> pts;
+    pts.reserve(leg.via.size() + 6);
+    pts.insert(pts.end(), {fx, fy, fz});
+    pts.insert(pts.end(), leg.via.begin(), leg.via.end());
+    pts.insert(pts.end(), {tx, ty, tz});
+    std::size_t last = pts.size() / 3 - 1;
+    std::size_t i = 0;
+    while (i < last) {
+        std::size_t j = i + 1;
+        while (j < last && map_.lineFree(pts[3 * i], pts[3 * i + 1], pts[3 * i + 2], pts[3 * (j + 1)], pts[3 * (j + 1) + 1], pts[3 * (j + 1) + 2])) {
+            j++;
+        }
+        if (j < last) {
+            via.insert(via.end(), {pts[3 * j], pts[3 * j + 1], pts[3 * j + 2]});
+        }
+        i = j;
+    }
+    stats.planned++;
+    return true;
+}
+
+PlannerStats VoxelPlanner::planMission(WaypointStore &mission, float sx, float sy, float sz, unsigned threads) {
+    std::size_t n = mission.size();
+    std::vector<std::vector<float>> legs(n); // via-points of the leg ending at waypoint i
+    std::vector<PlannerStats> worker_stats(std::max(1u, threads));
+    std::vector<char> failed(n, 0);
+    std::atomic<std::size_t> next(0);
+
+    auto worker = [&](PlannerStats &stats) {
+        for (std::size_t i = next++; i < n; i = next++) {
+            float fx = (i == 0) ? sx : mission.x[i - 1];
+            float fy = (i == 0) ? sy : mission.y[i - 1];
+            float fz = (i == 0) ? sz : mission.z[i - 1];
+            failed[i] = !planLeg(fx, fy, fz, mission.x[i], mission.y[i], mission.z[i], legs[i], stats);
+        }
+    };
+    std::vector<std::thread> pool;
+    for (std::size_t t = 1; t < worker_stats.size(); t++) {
+        pool.emplace_back(worker, std::ref(worker_stats[t]));
+    }
+    worker(worker_stats[0]);
+    for (std::thread &t : pool) {
+        t.join(); // thread-local search buffers go with the thread
+    }
+
+    // failed legs again, one at a time on this thread, so only one wide search buffer exists at once
+    PlannerStats retry_stats;
+    for (std::size_t i = 0; i < n; i++) {
+        if (!failed[i]) {
+            continue;
+        }
+        float fx = (i == 0) ? sx : mission.x[i - 1];
+        float fy = (i == 0) ? sy : mission.y[i - 1];
+        float fz = (i == 0) ? sz : mission.z[i - 1];
+        planLeg(fx, fy, fz, mission.x[i], mission.y[i], mission.z[i], legs[i], retry_stats, true);
+    }
+    threadBuffers().release();
+
+    std::size_t total = n;
+    for (const std::vector<float> &via : legs) {
+        total += via.size() / 3;
+    }
+    WaypointStore out;
+    out.reserve(total);
+    for (std::size_t i = 0; i < n; i++) {
+        for (std::size_t k = 0; k < legs[i].size(); k += 3) {
+            out.push(legs[i][k], legs[i][k + 1], legs[i][k + 2], mission.yaw[i], 0.0f, WP_VIA, mission.priority[i]);
+        }
+        out.push(mission.x[i], mission.y[i], mission.z[i], mission.yaw[i], mission.hover[i], mission.flags[i], mission.priority[i]);
+    }
+    mission = std::move(out);
+
+    PlannerStats stats = retry_stats;
+    stats.legs = 0; // retried legs were counted in the first pass
+    for (const PlannerStats &s : worker_stats) {
+        stats.legs += s.legs;
+        stats.planned += s.planned;
+        stats.cached += s.cached;
+        stats.max_ms = std::max(stats.max_ms, s.max_ms);
+    }
+    return stats;
+}
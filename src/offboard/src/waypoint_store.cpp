@@ -0,0 +1,94 @@
+#include "offboard/waypoint_store.h"
+
+#include <algorithm>
+#include <cmath>
+
+void WaypointStore::reserve(std::size_t n) {
+    x.reserve(n);
+    y.reserve(n);
+    z.reserve(n);
+    yaw.reserve(n);
+    hover.reserve(n);
+    flags.reserve(n);
+    priority.reserve(n);
+}
+
+void WaypointStore::resize(std::size_t n) {
+    x.resize(n);
+    y.resize(n);
+    z.resize(n);
+    yaw.resize(n);
+    hover.resize(n);
+    flags.resize(n);
+    priority.resize(n);
+}
+
+void WaypointStore::clear() {
+    resize(0);
+}
+
+void WaypointStore::push(float px, float py, float pz, float pyaw, float phover, uint8_t pflags, uint8_t ppriority) {
+    x.push_back(px);
+    y.push_back(py);
+    z.push_back(pz);
+    yaw.push_back(pyaw);
+    hover.push_back(phover);
+    flags.push_back(pflags);
+    priority.push_back(ppriority);
+}
+
+void WaypointStore::set(std::size_t i, float px, float py, float pz, float pyaw, float phover, uint8_t pflags, uint8_t ppriority) {
+    x[i] = px;
+    y[i] = py;
+    z[i] = pz;
+    yaw[i] = pyaw;
+    hover[i] = phover;
+    flags[i] = pflags;
+    priority[i] = ppriority;
+}
+
+geometry_msgs::PoseStamped WaypointStore::toPose(std::size_t i) const {
+    geometry_msgs::PoseStamped pose;
+    pose.pose.position.x = x[i];
+    pose.pose.position.y = y[i];
+    pose.pose.position.z = z[i];
+    pose.pose.orientation.z = std::sin(0.5 * yaw[i]); // rotation about z only, same as tf::createQuaternionMsgFromYaw
+    pose.pose.orientation.w = std::cos(0.5 * yaw[i]);
+    return pose;
+}
+
+/* gather every column through the same index list, one pass per column */
+template <class T>
+static void permuteColumn(std::vector<T> &column, const std::vector<uint32_t> &order) {
+    std::vector<T> out(order.size());
+    for (std::size_t i = 0; i < order.size(); i++) {
+        out[i] = column[order[i]];
+    }
+    column.swap(out);
+}
+
+void WaypointStore::permute(const std::vector<uint32_t> &order) {
+    permuteColumn(x, order);
+    permuteColumn(y, order);
+    permuteColumn(z, order);
+    permuteColumn(yaw, order);
+    permuteColumn(hover, order);
+    permuteColumn(flags, order);
+    permuteColumn(priority, order);
+}
+
+void WaypointStore::sortByPriority() {
+    std::vector<uint32_t> order(size());
+    for (std::size_t i = 0; i < order.size(); i++) {
+        order[i] = static_cast<uint32_t>(i);
+    }
+    std::stable_sort(order.begin(), order.end(), [this](uint32_t l, uint32_t r) {
+        return priority[l] > priority[r];
+    });
+    permute(order);
+}
+
+std::size_t WaypointStore::memoryBytes() const {
+    return (x.capacity() + y.capacity() + z.capacity() + yaw.capacity() + hover.capacity()) * sizeof(float)
+         + (flags.capacity() + priority.capacity()) * sizeof(uint8_t);
+}
@@ -0,0 +1,89 @@
+/* memory and iteration benchmark of WaypointStore against a PoseStamped array
+   usage: rosrun offboard waypoint_store_bench [number of waypoints] */
+#include "offboard/waypoint_store.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+static double msSince(Clock::time_point t_start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - t_start).count();
+}
+
+/* what ArrayQueue used to hold per waypoint, plus the priority the old layout had no room for */
+struct PoseRecord {
+    geometry_msgs::PoseStamped pose;
+    uint8_t priority;
+};
+
+int main(int argc, char **argv)
+{
+    std::size_t n = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+
+    Clock::time_point t_start = Clock::now();
+    WaypointStore store;
+    store.reserve(n);
+    for (std::size_t i = 0; i < n; i++) {
+        store.push(i * 0.1f, (i % 100) * 0.5f, 5.0f, 0.0f, 0.0f, (i % 50 == 0) ? WP_DELIVERY : 0, i % 7);
+    }
+    double soa_fill = msSince(t_start);
+
+    t_start = Clock::now();
+    std::vector<PoseRecord> poses(n);
+    for (std::size_t i = 0; i < n; i++) {
+        poses[i].pose.header.frame_id = "map";
+        poses[i].pose.pose.position.x = i * 0.1f;
+        poses[i].pose.pose.position.y = (i % 100) * 0.5f;
+        poses[i].pose.pose.position.z = 5.0f;
+        poses[i].pose.pose.orientation.w = 1.0;
+        poses[i].priority = i % 7;
+    }
+    double aos_fill = msSince(t_start);
+
+    // path length, the typical full scan (planning, progress estimate)
+    t_start = Clock::now();
+    double soa_length = 0.0;
+    for (std::size_t i = 1; i < n; i++) {
+        float dx = store.x[i] - store.x[i - 1], dy = store.y[i] - store.y[i - 1], dz = store.z[i] - store.z[i - 1];
+        soa_length += std::sqrt(dx * dx + dy * dy + dz * dz);
+    }
+    double soa_scan = msSince(t_start);
+
+    t_start = Clock::now();
+    double aos_length = 0.0;
+    for (std::size_t i = 1; i < n; i++) {
+        const geometry_msgs::Point &a = poses[i - 1].pose.pose.position, &b = poses[i].pose.pose.position;
+        aos_length += std::sqrt((b.x - a.x) * (b.x - a.x) + (b.y - a.y) * (b.y - a.y) + (b.z - a.z) * (b.z - a.z));
+    }
+    double aos_scan = msSince(t_start);
+
+    t_start = Clock::now();
+    store.sortByPriority();
+    double soa_sort = msSince(t_start);
+
+    t_start = Clock::now();
+    std::stable_sort(poses.begin(), poses.end(), [](const PoseRecord &l, const PoseRecord &r) {
+        return l.priority > r.priority;
+    });
+    double aos_sort = msSince(t_start);
+
+    t_start = Clock::now();
+    double check = 0.0;
+    for (std::size_t i = 0; i < n; i++) {
+        check += store.toPose(i).pose.orientation.w;
+    }
+    double to_pose = msSince(t_start);
+
+    std::printf("[ INFO] %zu waypoint(s)\n", n);
+    std::printf("          memory: SoA %.1f (MiB), PoseStamped %.1f (MiB)\n", store.memoryBytes() / 1048576.0, n * sizeof(PoseRecord) / 1048576.0);
+    std::printf("          fill:   SoA %.2f (ms), PoseStamped %.2f (ms)\n", soa_fill, aos_fill);
+    std::printf("          scan:   SoA %.2f (ms), PoseStamped %.2f (ms) (length %.0f / %.0f m)\n", soa_scan, aos_scan, soa_length, aos_length);
+    std::printf("          sort:   SoA %.2f (ms), PoseStamped %.2f (ms)\n", soa_sort, aos_sort);
+    std::printf("          toPose: %.2f (ms) for all waypoints (%.0f)\n", to_pose, check);
+    return 0;
+}